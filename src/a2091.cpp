@@ -292,10 +292,25 @@ static struct wd_state *scsi_units[MAX_SCSI_UNITS + 1];
 static void wd_init(void);
 static void wd_addreset(void);
 
+static void scsi_thread_stop(struct wd_state *wd)
+{
+	if (wd->scsi_thread_running > 0) {
+		wd->scsi_thread_running = 0;
+		write_comm_pipe_u32 (&wd->requests, 0xffffffff, 1);
+		while(wd->scsi_thread_running == 0)
+			sleep_millis (10);
+	}
+	if (wd->scsi_thread_running) {
+		destroy_comm_pipe (&wd->requests);
+		wd->scsi_thread_running = 0;
+	}
+}
+
 static void freencrunit(struct wd_state *wd)
 {
 	if (!wd)
 		return;
+	scsi_thread_stop(wd);
 	for (int i = 0; i < MAX_SCSI_UNITS; i++) {
 		if (scsi_units[i] == wd) {
 			scsi_units[i] = NULL;
@@ -3982,13 +3997,6 @@ static void a3000scsi_free (void)
 	if (!wd)
 		return;
 	freencrunit(wd);
-	if (wd->scsi_thread_running > 0) {
-		wd->scsi_thread_running = 0;
-		write_comm_pipe_u32 (&wd->requests, 0xffffffff, 1);
-		while(wd->scsi_thread_running == 0)
-			sleep_millis (10);
-		wd->scsi_thread_running = 0;
-	}
 }
 
 void a2090_add_scsi_unit(int ch, struct uaedev_config_info *ci, struct romconfig *rc)
@@ -32,6 +32,7 @@
 #include "uae.h"
 #include "gui.h"
 #include "xwin.h"
+#include "drawing.h"
 #include "debug.h"
 #ifdef WITH_SNDBOARD
 #include "sndboard.h"
@@ -86,25 +87,21 @@ STATIC_INLINE bool usehacks(void)
 }
 
 #define SINC_QUEUE_MAX_AGE 2048
-/* Queue length 256 implies minimum emulated period of 8. This should be
- * sufficient for all imaginable purposes. This must be power of two. */
-#define SINC_QUEUE_LENGTH 256
+/* At most 256 queued transitions are mixed into one output sample, which
+ * implies minimum emulated period of 8. This should be sufficient for all
+ * imaginable purposes. The queue itself is longer so that batched output
+ * can still look back at transitions older than the current head.
+ * Both must be powers of two. */
+#define SINC_QUEUE_LIVE 256
+#define SINC_QUEUE_LENGTH 1024
 
 #include "sinctable.cpp.in"
 
-typedef struct {
-	int time, output;
-} sinc_queue_t;
-
 struct audio_channel_data2
 {
 	int current_sample, last_sample;
 	uae_u8 new_sample;
 	int sample_accum, sample_accum_time;
-	int sinc_output_state;
-	sinc_queue_t sinc_queue[SINC_QUEUE_LENGTH];
-	int sinc_queue_time;
-	int sinc_queue_head;
 	int audvol;
 	int mixvol;
 	unsigned int adk_mask;
@@ -116,8 +113,30 @@ struct audio_stream_data
 	struct audio_channel_data2 data[AUDIO_CHANNEL_MAX_STREAM_CH];
 	SOUND_STREAM_CALLBACK cb;
 	void *cb_data;
+	/* block stream: producer writes frames to the ring, the mixer
+	 * resamples them at output sample points, no per-sample events */
+	bool block;
+	int block_ch;
+	uae_s16 *ring;
+	volatile uae_u32 ring_read, ring_write;
+	uae_u32 frac;
+	float evt;
+	int prev[AUDIO_CHANNEL_MAX_STREAM_CH], next[AUDIO_CHANNEL_MAX_STREAM_CH];
+	/* optional per channel volume (0 to 32768) applied at mix time */
+	const int *volume;
+	/* call cb when the mixer gets within AUDIO_BLOCK_NOTIFY_LEAD
+	 * frames of ring position notify_pos */
+	bool notify;
+	uae_u32 notify_pos;
 };
 
+/* Block stream ring size in frames (power of two), the refill callback is
+ * called when less than half of it is queued. */
+#define AUDIO_BLOCK_RING 2048
+/* Frames left to play before a notify position when the callback fires,
+ * gives the producer time to queue the next block without a gap. */
+#define AUDIO_BLOCK_NOTIFY_LEAD 256
+
 #define FIR_WIDTH 512
 #define VOLCNT_BUFFER_SIZE 4096
 union sIntFlt { uae_u32 U32; float F32; };
@@ -167,6 +186,54 @@ struct audio_channel_data
 static int audio_extra_streams[AUDIO_CHANNEL_STREAMS];
 static int audio_total_extra_streams;
 
+/* Paula BLEP queue. Time stamps and output deltas live in separate arrays
+ * so that the mixing loops in sinc_render() run without branches. */
+struct sinc_channel_state
+{
+	int output_state;
+	int head;
+	int stamp[SINC_QUEUE_LENGTH];
+	int delta[SINC_QUEUE_LENGTH];
+	/* mixed transition count and queue head of the last rendered sample */
+	int live, livehead;
+	/* transitions queued since the oldest pending batched sample */
+	int pushes;
+};
+static struct sinc_channel_state sinc_state[AUDIO_CHANNELS_PAULA];
+static int sinc_queue_time;
+
+/* Extra stream samples taken at one output sample point, up to
+ * AUDIO_EXTRA_MIX_CH per stream. */
+#define AUDIO_EXTRA_MIX_CH 6
+#define AUDIO_EXTRA_SAMPLES (AUDIO_CHANNEL_STREAMS * AUDIO_EXTRA_MIX_CH)
+
+/* Sinc output is rendered in batches. update_audio() only records the BLEP
+ * queue position at each output sample point, sinc_batch_flush() later does
+ * the convolution for the whole batch one channel at a time and then mixes
+ * and outputs all samples in one loop without indirect calls. */
+#define SINC_BATCH_SIZE 256
+
+enum {
+	SINC_BATCH_OFF = 0,
+	SINC_BATCH_MONO,
+	SINC_BATCH_STEREO,
+	SINC_BATCH_SURROUND
+};
+
+struct sinc_batch_sample
+{
+	int time;
+	int table;
+	int head[AUDIO_CHANNELS_PAULA];
+	int state[AUDIO_CHANNELS_PAULA];
+	int out[AUDIO_CHANNELS_PAULA];
+	bool hasextra;
+};
+static struct sinc_batch_sample sinc_batch[SINC_BATCH_SIZE];
+static int sinc_batch_extra[SINC_BATCH_SIZE][AUDIO_EXTRA_SAMPLES];
+static int sinc_batch_cnt, sinc_batch_mode;
+static void sinc_batch_flush(void);
+
 static int samplecnt;
 #if SOUNDSTUFF > 0
 static int extrasamples, outputsample, doublesample;
@@ -355,7 +422,7 @@ static void do_samplerip (struct audio_channel_data *adp)
 
 static struct audio_channel_data audio_channel[AUDIO_CHANNELS_PAULA];
 static struct audio_stream_data audio_stream[AUDIO_CHANNEL_STREAMS];
-static struct audio_channel_data2 *audio_data[AUDIO_CHANNELS_PAULA + AUDIO_CHANNEL_STREAMS * AUDIO_CHANNEL_MAX_STREAM_CH];
+static struct audio_channel_data2 *audio_data[AUDIO_CHANNELS_PAULA + AUDIO_CHANNEL_STREAMS * AUDIO_CHANNEL_MAX_STREAM_CH + 1];
 int sound_available = 0;
 void (*sample_handler) (void);
 static void(*sample_prehandler) (unsigned long best_evtime);
@@ -613,62 +680,97 @@ static void sinc_prehandler_paula (unsigned long best_evtime)
 {
 	int i, output;
 	struct audio_channel_data2 *acd;
+	bool flush = false;
 
 	for (i = 0; i < AUDIO_CHANNELS_PAULA; i++)  {
+		struct sinc_channel_state *scs = &sinc_state[i];
 		acd = audio_data[i];
 		int vol = acd->mixvol;
 		output = (acd->current_sample * vol) & acd->adk_mask;
 
 		/* if output state changes, record the state change and also
 		 * write data into sinc queue for mixing in the BLEP */
-		if (acd->sinc_output_state != output) {
-			acd->sinc_queue_head = (acd->sinc_queue_head - 1) & (SINC_QUEUE_LENGTH - 1);
-			acd->sinc_queue[acd->sinc_queue_head].time = acd->sinc_queue_time;
-			acd->sinc_queue[acd->sinc_queue_head].output = output - acd->sinc_output_state;
-			acd->sinc_output_state = output;
+		if (scs->output_state != output) {
+			scs->head = (scs->head - 1) & (SINC_QUEUE_LENGTH - 1);
+			scs->stamp[scs->head] = sinc_queue_time;
+			scs->delta[scs->head] = output - scs->output_state;
+			scs->output_state = output;
+			if (sinc_batch_cnt && ++scs->pushes >= SINC_QUEUE_LENGTH - SINC_QUEUE_LIVE)
+				flush = true;
 		}
-
-		acd->sinc_queue_time += best_evtime;
 	}
+	sinc_queue_time += best_evtime;
+
+	/* render pending samples before their queue entries get overwritten */
+	if (flush)
+		sinc_batch_flush();
 }
 
-/* this interpolator performs BLEP mixing (bleps are shaped like integrated sinc
-* functions) with a type of BLEP that matches the filtering configuration. */
-static void samplexx_sinc_handler (int *datasp, int ch_start, int ch_num)
+static int sinc_table (void)
 {
-	int n, i, k;
-	int const *winsinc;
+	int n;
 
-	if (sound_use_filter_sinc && ch_start == 0) {
+	if (sound_use_filter_sinc) {
 		n = (sound_use_filter_sinc == FILTER_MODEL_A500 || sound_use_filter_sinc == FILTER_MODEL_A500_FIXEDONLY) ? 0 : 2;
 		if (led_filter_on)
 			n += 1;
 	} else {
 		n = 4;
 	}
-	winsinc = winsinc_integral[n];
+	return n;
+}
 
+/* BLEP mix one channel at queue time 'time', 'head' and 'state' being the
+ * queue head and output state at that time. Must be called in time order
+ * for each channel, the count of still audible transitions is carried over
+ * from the previous sample. */
+STATIC_INLINE int sinc_render (struct sinc_channel_state *scs, const int *winsinc, int time, int head, int state)
+{
+	int live, first, v;
 
-	for (i = ch_start, k = 0; k < ch_num; i++, k++) {
-		int j, v;
-		struct audio_channel_data2 *acd = audio_data[i];
-		/* The sum rings with harmonic components up to infinity... */
-		int sum = acd->sinc_output_state << 17;
-		/* ...but we cancel them through mixing in BLEPs instead */
-		int offsetpos = acd->sinc_queue_head & (SINC_QUEUE_LENGTH - 1);
-		for (j = 0; j < SINC_QUEUE_LENGTH; j += 1) {
-			int age = acd->sinc_queue_time - acd->sinc_queue[offsetpos].time;
-			if (age >= SINC_QUEUE_MAX_AGE || age < 0)
-				break;
-			sum -= winsinc[age] * acd->sinc_queue[offsetpos].output;
-			offsetpos = (offsetpos + 1) & (SINC_QUEUE_LENGTH - 1);
-		}
-		v = sum >> 15;
-		if (v > 32767)
-			v = 32767;
-		else if (v < -32768)
-			v = -32768;
-		datasp[k] = v;
+	live = ((scs->livehead - head) & (SINC_QUEUE_LENGTH - 1)) + scs->live;
+	if (live > SINC_QUEUE_LIVE)
+		live = SINC_QUEUE_LIVE;
+	/* queue is in time order, expired transitions are at the tail */
+	while (live > 0) {
+		int age = time - scs->stamp[(head + live - 1) & (SINC_QUEUE_LENGTH - 1)];
+		if (age < SINC_QUEUE_MAX_AGE && age >= 0)
+			break;
+		live--;
+	}
+	scs->live = live;
+	scs->livehead = head;
+
+	/* The sum rings with harmonic components up to infinity... */
+	int sum = state << 17;
+	/* ...but we cancel them through mixing in BLEPs instead */
+	first = SINC_QUEUE_LENGTH - head;
+	if (first > live)
+		first = live;
+	const int *stamp = scs->stamp + head;
+	const int *delta = scs->delta + head;
+	for (int j = 0; j < first; j++)
+		sum -= winsinc[time - stamp[j]] * delta[j];
+	for (int j = 0; j < live - first; j++)
+		sum -= winsinc[time - scs->stamp[j]] * scs->delta[j];
+
+	v = sum >> 15;
+	if (v > 32767)
+		v = 32767;
+	else if (v < -32768)
+		v = -32768;
+	return v;
+}
+
+/* this interpolator performs BLEP mixing (bleps are shaped like integrated sinc
+* functions) with a type of BLEP that matches the filtering configuration. */
+static void samplexx_sinc_handler (int *datasp)
+{
+	const int *winsinc = winsinc_integral[sinc_table ()];
+
+	for (int i = 0; i < AUDIO_CHANNELS_PAULA; i++) {
+		struct sinc_channel_state *scs = &sinc_state[i];
+		datasp[i] = sinc_render (scs, winsinc, sinc_queue_time, scs->head, scs->output_state);
 	}
 }
 
@@ -702,63 +804,141 @@ static void get_extra_channels(int *data1, int *data2, int sample1, int sample2)
 	}
 }
 
-static void do_extra_channels(int idx, int ch, int *data1, int *data2, int *data3, int *data4, int *data5, int *data6)
-{
-	idx += AUDIO_CHANNELS_PAULA;
-	if (ch == 2) {
-		int datas[2];
-		samplexx_anti_handler(datas, idx, 2);
-		get_extra_channels(data1, data2, datas[0], datas[1]);
-	} else if (ch == 1) {
-		int datas[1];
-		samplexx_anti_handler(datas, idx, 1);
-		int d1 = *data1 + datas[0];
-		if (d1 < -32768)
-			d1 = -32768;
-		if (d1 > 32767)
-			d1 = 32767;
-		*data1 = d1;
-		if (data2)
-			*data2 = d1;
-	} else if (ch > 2) {
-		int datas[AUDIO_CHANNEL_MAX_STREAM_CH];
-		samplexx_anti_handler(datas, idx, 6);
-		get_extra_channels(data1, data2, datas[0], datas[1]);
-		if (data3 && data4)
-			get_extra_channels(data3, data4, datas[2], datas[3]);
-		if (data5 && data6)
-			get_extra_channels(data5, data6, datas[4], datas[5]);
+/* Resample cnt output samples from a block stream ring into
+ * out[0..cnt-1][offset...], linear interpolation between source frames.
+ * Underruns fade to silence without advancing the read position. */
+static void block_stream_render(struct audio_stream_data *asd, int (*out)[AUDIO_EXTRA_SAMPLES], int offset, int cnt)
+{
+	int ch = asd->block_ch;
+	int mixch = ch > 2 ? AUDIO_EXTRA_MIX_CH : ch;
+	int srcch = ch < mixch ? ch : mixch;
+	uae_u32 step = asd->evt > 0 ? (uae_u32)(scaled_sample_evtime * 65536.0f / asd->evt) : 0;
+	uae_u32 rd = asd->ring_read;
+	uae_u32 wr = __atomic_load_n(&asd->ring_write, __ATOMIC_ACQUIRE);
+	uae_u32 frac = asd->frac;
+
+	for (int j = 0; j < cnt; j++) {
+		int f = frac >> 4;
+		for (int c = 0; c < mixch; c++)
+			out[j][offset + c] = asd->prev[c] + (((asd->next[c] - asd->prev[c]) * f) >> 12);
+		frac += step;
+		while (frac >= 65536) {
+			frac -= 65536;
+			if (rd != wr) {
+				const uae_s16 *src = asd->ring + (rd & (AUDIO_BLOCK_RING - 1)) * ch;
+				const int *vol = asd->volume;
+				for (int c = 0; c < srcch; c++) {
+					asd->prev[c] = asd->next[c];
+					asd->next[c] = vol ? src[c] * vol[c] / 32768 : src[c];
+				}
+				rd++;
+			} else {
+				for (int c = 0; c < srcch; c++) {
+					asd->prev[c] = asd->next[c];
+					asd->next[c] = 0;
+				}
+			}
+		}
 	}
+	asd->frac = frac;
+	__atomic_store_n(&asd->ring_read, rd, __ATOMIC_RELEASE);
 }
 
-static void get_extra_channels_sample2(int *data1, int *data2, int mode)
+/* Sound is emulated without output: consume block stream frames at
+ * their source rate so the producers keep getting refill callbacks and
+ * the stream positions keep moving. */
+static void block_streams_discard(int cycles)
+{
+	for (int i = 0; i < AUDIO_CHANNEL_STREAMS; i++) {
+		struct audio_stream_data *asd = &audio_stream[i];
+		if (!audio_extra_streams[i] || !asd->block || asd->evt <= 0)
+			continue;
+		float pos = asd->frac / 65536.0f + cycles / asd->evt;
+		uae_u32 frames = (uae_u32)pos;
+		asd->frac = (uae_u32)((pos - frames) * 65536.0f);
+		uae_u32 rd = asd->ring_read;
+		uae_u32 fill = __atomic_load_n(&asd->ring_write, __ATOMIC_ACQUIRE) - rd;
+		if (frames > fill)
+			frames = fill;
+		if (!frames)
+			continue;
+		rd += frames;
+		const uae_s16 *src = asd->ring + ((rd - 1) & (AUDIO_BLOCK_RING - 1)) * asd->block_ch;
+		const int *vol = asd->volume;
+		for (int c = 0; c < asd->block_ch && c < AUDIO_EXTRA_MIX_CH; c++)
+			asd->prev[c] = asd->next[c] = vol ? src[c] * vol[c] / 32768 : src[c];
+		__atomic_store_n(&asd->ring_read, rd, __ATOMIC_RELEASE);
+	}
+}
+
+/* Take the current samples of all extra streams, returns NULL if none.
+ * Block streams are skipped when blocks is false, sinc batch mode
+ * renders them for the whole batch in sinc_batch_flush(). */
+static const int *sample_extra_channels2(int *extra, bool blocks)
 {
 	if (!audio_total_extra_streams)
-		return;
-	int idx = 0;
+		return NULL;
+	int idx = AUDIO_CHANNELS_PAULA;
 	for (int i = 0; i < AUDIO_CHANNEL_STREAMS; i++) {
 		int ch = audio_extra_streams[i];
-		if (ch) {
-			do_extra_channels(idx, ch, data1, data2, NULL, NULL, NULL, NULL);
+		if (!ch)
+			continue;
+		if (audio_stream[i].block) {
+			if (blocks)
+				block_stream_render(&audio_stream[i], (int(*)[AUDIO_EXTRA_SAMPLES])extra, i * AUDIO_EXTRA_MIX_CH, 1);
+		} else {
+			samplexx_anti_handler(extra + i * AUDIO_EXTRA_MIX_CH, idx, ch > 2 ? AUDIO_EXTRA_MIX_CH : ch);
 			idx += ch;
 		}
 	}
+	return extra;
 }
 
-static void get_extra_channels_sample6(int *data1, int *data2, int *data3, int *data4, int *data5, int *data6, int mode)
+static const int *sample_extra_channels(int *extra)
+{
+	return sample_extra_channels2(extra, true);
+}
+
+static void mix_extra_channels(const int *extra, int *data1, int *data2, int *data3, int *data4, int *data5, int *data6)
 {
-	if (!audio_total_extra_streams)
-		return;
-	int idx = 0;
 	for (int i = 0; i < AUDIO_CHANNEL_STREAMS; i++) {
 		int ch = audio_extra_streams[i];
-		if (ch) {
-			do_extra_channels(idx, ch, data1, data2, data3, data4, data5, data6);
-			idx += ch;
+		const int *datas = extra + i * AUDIO_EXTRA_MIX_CH;
+		if (ch == 2) {
+			get_extra_channels(data1, data2, datas[0], datas[1]);
+		} else if (ch == 1) {
+			int d1 = *data1 + datas[0];
+			if (d1 < -32768)
+				d1 = -32768;
+			if (d1 > 32767)
+				d1 = 32767;
+			*data1 = d1;
+			if (data2)
+				*data2 = d1;
+		} else if (ch > 2) {
+			get_extra_channels(data1, data2, datas[0], datas[1]);
+			if (data3 && data4)
+				get_extra_channels(data3, data4, datas[2], datas[3]);
+			if (data5 && data6)
+				get_extra_channels(data5, data6, datas[4], datas[5]);
 		}
 	}
 }
 
+static void get_extra_channels_sample2(int *data1, int *data2, int mode)
+{
+	int extra[AUDIO_EXTRA_SAMPLES];
+	if (sample_extra_channels(extra))
+		mix_extra_channels(extra, data1, data2, NULL, NULL, NULL, NULL);
+}
+
+static void get_extra_channels_sample6(int *data1, int *data2, int *data3, int *data4, int *data5, int *data6, int mode)
+{
+	int extra[AUDIO_EXTRA_SAMPLES];
+	if (sample_extra_channels(extra))
+		mix_extra_channels(extra, data1, data2, data3, data4, data5, data6);
+}
+
 static void set_sound_buffers(void)
 {
 #if SOUNDSTUFF > 1
@@ -833,23 +1013,31 @@ static void check_sound_buffers(void)
 #endif
 }
 
-static void sample16i_sinc_handler (void)
+static void sample16i_sinc_output (const int *datas, const int *extra)
 {
-	int datas[AUDIO_CHANNELS_PAULA], data1;
+	int data1;
 
-	samplexx_sinc_handler (datas, 0, AUDIO_CHANNELS_PAULA);
 	data1 = datas[0] + datas[3] + datas[1] + datas[2];
 	data1 = FINISH_DATA (data1, 18, 0);
 	
 	do_filter(&data1, 0);
 
-	get_extra_channels_sample2(&data1, NULL, 2);
+	if (extra)
+		mix_extra_channels(extra, &data1, NULL, NULL, NULL, NULL, NULL);
 
 	set_sound_buffers ();
 	PUT_SOUND_WORD_MONO (data1);
 	check_sound_buffers ();
 }
 
+static void sample16i_sinc_handler (void)
+{
+	int datas[AUDIO_CHANNELS_PAULA], extra[AUDIO_EXTRA_SAMPLES];
+
+	samplexx_sinc_handler (datas);
+	sample16i_sinc_output (datas, sample_extra_channels (extra));
+}
+
 void sample16_handler (void)
 {
 	int data0 = audio_channel[0].data.current_sample;
@@ -1153,12 +1341,10 @@ static void sample16si_anti_handler(void)
 	check_sound_buffers();
 }
 
-static void sample16ss_sinc_handler(void)
+static void sample16ss_sinc_output(const int *datas, const int *extra)
 {
 	int data0, data1, data2, data3, data4, data5;
-	int datas[AUDIO_CHANNELS_PAULA];
 
-	samplexx_sinc_handler(datas, 0, AUDIO_CHANNELS_PAULA);
 	data0 = FINISH_DATA (datas[0], 16, 0);
 	data1 = FINISH_DATA (datas[1], 16, 0);
 	data2 = FINISH_DATA (datas[2], 16, 1);
@@ -1172,7 +1358,8 @@ static void sample16ss_sinc_handler(void)
 	if (active_sound_stereo >= SND_6CH)
 		make6ch(data0, data1, data2, data3, &data4, &data5);
 
-	get_extra_channels_sample6(&data0, &data1, &data3, &data2, &data4, &data5, 0);
+	if (extra)
+		mix_extra_channels(extra, &data0, &data1, &data3, &data2, &data4, &data5);
 
 	set_sound_buffers ();
 	put_sound_word_right(data0);
@@ -1190,11 +1377,18 @@ static void sample16ss_sinc_handler(void)
 	check_sound_buffers ();
 }
 
-static void sample16si_sinc_handler (void)
+static void sample16ss_sinc_handler(void)
 {
-	int datas[AUDIO_CHANNELS_PAULA], data1, data2;
+	int datas[AUDIO_CHANNELS_PAULA], extra[AUDIO_EXTRA_SAMPLES];
+
+	samplexx_sinc_handler(datas);
+	sample16ss_sinc_output(datas, sample_extra_channels(extra));
+}
+
+static void sample16si_sinc_output (const int *datas, const int *extra)
+{
+	int data1, data2;
 
-	samplexx_sinc_handler (datas, 0, AUDIO_CHANNELS_PAULA);
 	data1 = datas[0] + datas[3];
 	data2 = datas[1] + datas[2];
 	data1 = FINISH_DATA (data1, 17, 0);
@@ -1203,7 +1397,8 @@ static void sample16si_sinc_handler (void)
 	do_filter(&data1, 0);
 	do_filter(&data2, 1);
 
-	get_extra_channels_sample2(&data1, &data2, 2);
+	if (extra)
+		mix_extra_channels(extra, &data1, &data2, NULL, NULL, NULL, NULL);
 
 	set_sound_buffers ();
 	put_sound_word_right(data1);
@@ -1211,6 +1406,71 @@ static void sample16si_sinc_handler (void)
 	check_sound_buffers ();
 }
 
+static void sample16si_sinc_handler (void)
+{
+	int datas[AUDIO_CHANNELS_PAULA], extra[AUDIO_EXTRA_SAMPLES];
+
+	samplexx_sinc_handler (datas);
+	sample16si_sinc_output (datas, sample_extra_channels (extra));
+}
+
+static void sinc_batch_add (void)
+{
+	struct sinc_batch_sample *sbs = &sinc_batch[sinc_batch_cnt];
+
+	if (!sinc_batch_cnt) {
+		for (int i = 0; i < AUDIO_CHANNELS_PAULA; i++)
+			sinc_state[i].pushes = 0;
+	}
+	sbs->time = sinc_queue_time;
+	sbs->table = sinc_table ();
+	for (int i = 0; i < AUDIO_CHANNELS_PAULA; i++) {
+		sbs->head[i] = sinc_state[i].head;
+		sbs->state[i] = sinc_state[i].output_state;
+	}
+	sbs->hasextra = sample_extra_channels2 (sinc_batch_extra[sinc_batch_cnt], false) != NULL;
+	sinc_batch_cnt++;
+	if (sinc_batch_cnt >= SINC_BATCH_SIZE)
+		sinc_batch_flush ();
+}
+
+static void sinc_batch_flush (void)
+{
+	int cnt = sinc_batch_cnt;
+
+	if (!cnt)
+		return;
+	sinc_batch_cnt = 0;
+
+	for (int i = 0; i < AUDIO_CHANNELS_PAULA; i++) {
+		struct sinc_channel_state *scs = &sinc_state[i];
+		for (int j = 0; j < cnt; j++) {
+			struct sinc_batch_sample *sbs = &sinc_batch[j];
+			sbs->out[i] = sinc_render (scs, winsinc_integral[sbs->table], sbs->time, sbs->head[i], sbs->state[i]);
+		}
+	}
+	for (int i = 0; i < AUDIO_CHANNEL_STREAMS; i++) {
+		if (audio_extra_streams[i] && audio_stream[i].block)
+			block_stream_render (&audio_stream[i], sinc_batch_extra, i * AUDIO_EXTRA_MIX_CH, cnt);
+	}
+
+	switch (sinc_batch_mode)
+	{
+	case SINC_BATCH_MONO:
+		for (int j = 0; j < cnt; j++)
+			sample16i_sinc_output (sinc_batch[j].out, sinc_batch[j].hasextra ? sinc_batch_extra[j] : NULL);
+		break;
+	case SINC_BATCH_STEREO:
+		for (int j = 0; j < cnt; j++)
+			sample16si_sinc_output (sinc_batch[j].out, sinc_batch[j].hasextra ? sinc_batch_extra[j] : NULL);
+		break;
+	case SINC_BATCH_SURROUND:
+		for (int j = 0; j < cnt; j++)
+			sample16ss_sinc_output (sinc_batch[j].out, sinc_batch[j].hasextra ? sinc_batch_extra[j] : NULL);
+		break;
+	}
+}
+
 void sample16s_handler (void)
 {
 	int data0 = audio_channel[0].data.current_sample;
@@ -1458,6 +1718,8 @@ static void audio_event_reset (void)
 {
 	int i;
 
+	/* render what is batched before the channel states are cleared */
+	sinc_batch_flush ();
 	last_cycles = get_cycles ();
 	next_sample_evtime = scaled_sample_evtime;
 	for (i = 0; i < AUDIO_CHANNELS_PAULA; i++) {
@@ -1476,6 +1738,7 @@ static void audio_event_reset (void)
 
 void audio_deactivate (void)
 {
+	sinc_batch_flush ();
 	gui_data.sndbuf_status = 3;
 	gui_data.sndbuf = 0;
 	audio_work_to_do = 0;
@@ -2034,8 +2297,13 @@ void audio_reset (void)
 	free_ahi_v2();
 #endif
 #endif
+	/* output what is still batched while the stream layout is valid */
+	sinc_batch_flush ();
 	reset_sound ();
 	memset (sound_filter_state, 0, sizeof sound_filter_state);
+	memset (sinc_state, 0, sizeof sinc_state);
+	memset (sinc_batch, 0, sizeof sinc_batch);
+	memset (sinc_batch_extra, 0, sizeof sinc_batch_extra);
 	if (!isrestore ()) {
 		for (i = 0; i < AUDIO_CHANNELS_PAULA; i++) {
 			cdp = &audio_channel[i];
@@ -2150,6 +2418,7 @@ void set_audio (void)
 	int sep, delay;
 	int ch;
 
+	sinc_batch_flush ();
 	ch = sound_prefs_changed ();
 	if (ch >= 0)
 		close_sound ();
@@ -2274,10 +2543,19 @@ void set_audio (void)
 			: sample16ss_anti_handler);
 	}
 	sample_prehandler = NULL;
+	sinc_batch_mode = SINC_BATCH_OFF;
 	if (sample_handler == sample16si_sinc_handler || sample_handler == sample16i_sinc_handler || sample_handler == sample16ss_sinc_handler) {
 		sample_prehandler = sinc_prehandler_paula;
 		sound_use_filter_sinc = sound_use_filter;
 		sound_use_filter = 0;
+#if SOUNDSTUFF <= 1
+		/* volcnt mode updates the samples itself right before output */
+		if (!currprefs.sound_volcnt) {
+			sinc_batch_mode = sample_handler == sample16i_sinc_handler ? SINC_BATCH_MONO
+				: sample_handler == sample16si_sinc_handler ? SINC_BATCH_STEREO
+				: SINC_BATCH_SURROUND;
+		}
+#endif
 	} else if (sample_handler == sample16si_anti_handler || sample_handler == sample16i_anti_handler || sample_handler == sample16ss_anti_handler) {
 		sample_prehandler = anti_prehandler;
 	}
@@ -2355,6 +2633,7 @@ static void update_audio_volcnt(int cycles, float evtime, bool nextsmp)
 void update_audio (void)
 {
 	int n_cycles = 0;
+	int produce = currprefs.produce_sound;
 #if SOUNDSTUFF > 1
 	static int samplecounter;
 #endif
@@ -2366,7 +2645,16 @@ void update_audio (void)
 	if (!is_audio_active ())
 		goto end;
 
+#ifdef AMIBERRY
+	/* Output is paused while warping, only run the channel state machines
+	 * and let block streams drain at their own rate. */
+	if (produce > 1 && warp_present_active())
+		produce = 1;
+#endif
+
 	n_cycles = (int)(get_cycles () - last_cycles);
+	if (produce <= 1 && n_cycles > 0)
+		block_streams_discard(n_cycles);
 	while (n_cycles > 0) {
 		uae_u32 best_evtime = n_cycles + 1;
 		uae_u32 rounded;
@@ -2387,16 +2675,17 @@ void update_audio (void)
 		if ((next_sample_evtime - rounded) >= 0.5)
 			rounded++;
 
-		if (currprefs.produce_sound > 1 && best_evtime > rounded)
+		if (produce > 1 && best_evtime > rounded)
 			best_evtime = rounded;
 
 		if (best_evtime > n_cycles)
 			best_evtime = n_cycles;
 
 		/* Decrease time-to-wait counters */
-		next_sample_evtime -= best_evtime;
+		if (produce == currprefs.produce_sound)
+			next_sample_evtime -= best_evtime;
 
-		if (currprefs.produce_sound > 1) {
+		if (produce > 1) {
 			if (sample_prehandler)
 				sample_prehandler (best_evtime / CYCLE_UNIT);
 			if (extra_sample_prehandler)
@@ -2414,7 +2703,7 @@ void update_audio (void)
 
 		n_cycles -= best_evtime;
 
-		if (currprefs.produce_sound > 1) {
+		if (produce > 1) {
 			if (currprefs.sound_volcnt) {
 				bool nextsmp = false;
 				if (rounded == best_evtime) {
@@ -2443,7 +2732,10 @@ void update_audio (void)
 						}
 					}
 #endif
-					(*sample_handler) ();
+					if (sinc_batch_mode)
+						sinc_batch_add ();
+					else
+						(*sample_handler) ();
 #if SOUNDSTUFF > 1
 					if (outputsample == 0)
 						outputsample = -1;
@@ -2476,6 +2768,25 @@ void audio_evhandler (void)
 	schedule_audio ();
 }
 
+/* Ask block stream producers for more data when the ring runs low or
+ * the mixer is about to reach their notify position. */
+static void block_streams_refill (void)
+{
+	for (int i = 0; i < AUDIO_CHANNEL_STREAMS; i++) {
+		struct audio_stream_data *asd = &audio_stream[i];
+		if (!audio_extra_streams[i] || !asd->block || !asd->cb)
+			continue;
+		uae_u32 fill = __atomic_load_n(&asd->ring_write, __ATOMIC_ACQUIRE) - asd->ring_read;
+		bool notify = asd->notify && (int)(asd->notify_pos - asd->ring_read) <= AUDIO_BLOCK_NOTIFY_LEAD;
+		if (fill >= AUDIO_BLOCK_RING / 2 && !notify)
+			continue;
+		if (notify)
+			asd->notify = false;
+		if (!asd->cb(i + 1, asd->cb_data) && audio_extra_streams[i] && asd->block)
+			audio_enable_stream(false, i + 1, 0, NULL, NULL);
+	}
+}
+
 void audio_hsync (void)
 {
 	if (!currprefs.produce_sound)
@@ -2493,6 +2804,7 @@ void audio_hsync (void)
 	}
 	update_audio ();
 	previous_volcnt_update = 0;
+	block_streams_refill ();
 }
 
 void event_audxdat_func(uae_u32 v)
@@ -2766,6 +3078,7 @@ void led_filter_audio (void)
 
 void audio_vsync (void)
 {
+	sinc_batch_flush ();
 #if 0
 #if SOUNDSTUFF > 0
 	int max, min;
@@ -2879,10 +3192,15 @@ static void audio_set_extra_channels(void)
 	for (int i = 0; i < AUDIO_CHANNEL_STREAMS; i++) {
 		if (audio_extra_streams[i])
 			audio_total_extra_streams++;
+		// block streams don't go through the accumulators
+		if (audio_stream[i].block)
+			continue;
 		for (int j = 0; j < audio_extra_streams[i]; j++) {
 			audio_data[index++] = &audio_stream[i].data[j];
 		}
 	}
+	while (index < AUDIO_CHANNELS_PAULA + AUDIO_CHANNEL_STREAMS * AUDIO_CHANNEL_MAX_STREAM_CH)
+		audio_data[index++] = NULL;
 	set_extra_prehandler();
 }
 
@@ -2890,6 +3208,8 @@ int audio_enable_stream(bool enable, int streamid, int ch, SOUND_STREAM_CALLBACK
 {
 	if (streamid == 0)
 		return 0;
+	/* pending batched samples were taken with the old stream layout */
+	sinc_batch_flush();
 	if (!enable) {
 		if (streamid <= 0)
 			return 0;
@@ -2897,6 +3217,7 @@ int audio_enable_stream(bool enable, int streamid, int ch, SOUND_STREAM_CALLBACK
 		struct audio_stream_data *asd = audio_stream + streamid;
 		audio_extra_streams[streamid] = 0;
 		asd->evtime = MAX_EV;
+		asd->block = false;
 	} else {
 		if (streamid < 0) {
 			for (int i = 0; i < AUDIO_CHANNEL_STREAMS; i++) {
@@ -2913,6 +3234,7 @@ int audio_enable_stream(bool enable, int streamid, int ch, SOUND_STREAM_CALLBACK
 		asd->cb = cb;
 		asd->cb_data = cb_data;
 		asd->evtime = CYCLE_UNIT;
+		asd->block = false;
 		for (int i = 0; i < ch; i++) {
 			struct audio_channel_data2 *acd = &asd->data[i];
 			acd->adk_mask = 0xffffffff;
@@ -2924,11 +3246,90 @@ int audio_enable_stream(bool enable, int streamid, int ch, SOUND_STREAM_CALLBACK
 	return streamid + 1;
 }
 
+/* Block stream: the producer queues frames with audio_write_stream_block()
+ * from any single thread, evt is the source frame length in cycles. cb is
+ * called from the emulation thread when the ring runs low, returning false
+ * ends the stream. */
+int audio_enable_block_stream(int ch, float evt, SOUND_STREAM_CALLBACK cb, void *cb_data)
+{
+	if (ch <= 0 || ch > AUDIO_CHANNEL_MAX_STREAM_CH)
+		return 0;
+	int streamid = audio_enable_stream(true, -1, ch, cb, cb_data);
+	if (!streamid)
+		return 0;
+	struct audio_stream_data *asd = audio_stream + streamid - 1;
+	if (!asd->ring)
+		asd->ring = xcalloc(uae_s16, AUDIO_BLOCK_RING * AUDIO_CHANNEL_MAX_STREAM_CH);
+	asd->block_ch = ch;
+	asd->ring_read = asd->ring_write = 0;
+	asd->frac = 0;
+	asd->evt = evt;
+	memset(asd->prev, 0, sizeof asd->prev);
+	memset(asd->next, 0, sizeof asd->next);
+	asd->volume = NULL;
+	asd->notify = false;
+	asd->evtime = MAX_EV;
+	asd->block = true;
+	audio_set_extra_channels();
+	return streamid;
+}
+
+void audio_stream_block_rate(int streamid, float evt)
+{
+	if (streamid <= 0)
+		return;
+	audio_stream[streamid - 1].evt = evt;
+}
+
+/* Queue up to frames interleaved frames, volume (0 to 32768 per channel)
+ * can be NULL. Returns the number of frames queued. */
+int audio_write_stream_block(int streamid, const uae_s16 *data, int frames, const int *volume)
+{
+	if (streamid <= 0)
+		return 0;
+	struct audio_stream_data *asd = audio_stream + streamid - 1;
+	int ch = asd->block_ch;
+	uae_u32 wr = asd->ring_write;
+	uae_u32 rd = __atomic_load_n(&asd->ring_read, __ATOMIC_ACQUIRE);
+	int space = AUDIO_BLOCK_RING - (int)(wr - rd);
+	if (frames > space)
+		frames = space;
+	for (int i = 0; i < frames; i++, wr++, data += ch) {
+		uae_s16 *d = asd->ring + (wr & (AUDIO_BLOCK_RING - 1)) * ch;
+		if (volume) {
+			for (int c = 0; c < ch; c++)
+				d[c] = data[c] * volume[c] / 32768;
+		} else {
+			memcpy(d, data, ch * sizeof(uae_s16));
+		}
+	}
+	__atomic_store_n(&asd->ring_write, wr, __ATOMIC_RELEASE);
+	return frames;
+}
+
+/* Frames queued but not yet mixed. */
+int audio_stream_block_fill(int streamid)
+{
+	if (streamid <= 0)
+		return 0;
+	struct audio_stream_data *asd = audio_stream + streamid - 1;
+	return (int)(__atomic_load_n(&asd->ring_write, __ATOMIC_ACQUIRE) - __atomic_load_n(&asd->ring_read, __ATOMIC_ACQUIRE));
+}
+
+/* Total frames mixed since the stream was enabled. */
+uae_u32 audio_stream_block_position(int streamid)
+{
+	if (streamid <= 0)
+		return 0;
+	return __atomic_load_n(&audio_stream[streamid - 1].ring_read, __ATOMIC_ACQUIRE);
+}
+
 void audio_state_stream_state(int streamid, int *samplep, int highestch, unsigned int evt)
 {
 	streamid--;
 	struct audio_stream_data *asd = audio_stream + streamid;
 	if (highestch > audio_extra_streams[streamid]) {
+		sinc_batch_flush();
 		audio_extra_streams[streamid] = highestch;
 		audio_set_extra_channels();
 	}
@@ -2940,12 +3341,18 @@ void audio_state_stream_state(int streamid, int *samplep, int highestch, unsigne
 	asd->evtime = evt;
 }
 
-static uae_u32 cda_evt;
+static float cda_evt;
 static uae_s16 dummy_buffer[4] = { 0 };
 
+static bool audio_state_cda(int streamid, void *state);
+
 void update_cda_sound(float clk)
 {
-	cda_evt = (uae_u32)(clk * CYCLE_UNIT / 44100.0f);
+	cda_evt = clk * CYCLE_UNIT / 44100.0f;
+	for (int i = 0; i < AUDIO_CHANNEL_STREAMS; i++) {
+		if (audio_extra_streams[i] && audio_stream[i].block && audio_stream[i].cb == audio_state_cda)
+			audio_stream[i].evt = cda_evt;
+	}
 }
 
 void audio_cda_volume(struct cd_audio_state *cas, int left, int right)
@@ -2960,24 +3367,47 @@ void audio_cda_volume(struct cd_audio_state *cas, int left, int right)
 	}
 }
 
+/* CD audio block stream refill: queue as much of the current buffer as
+ * fits. The next buffer is requested when the mixer is within
+ * AUDIO_BLOCK_NOTIFY_LEAD frames of playing the end of the current one,
+ * not when it has been queued, so the drive's play position and subcode
+ * track what is heard. The drive thread double buffers, the next buffer
+ * is normally ready. cda_volume is applied by the mixer. */
 static bool audio_state_cda(int streamid, void *state)
 {
 	struct cd_audio_state *cas = (struct cd_audio_state*)state;
-	if (cas->cda_bufptr >= dummy_buffer && cas->cda_bufptr <= dummy_buffer + 4) {
-		audio_enable_stream(false, cas->cda_streamid, 0, NULL, NULL);
-		cas->cda_streamid = 0;
+	struct audio_stream_data *asd = audio_stream + streamid - 1;
+	if (cas->cda_streamid != streamid)
 		return false;
+	for (;;) {
+		if (cas->cda_pending) {
+			if ((int)(asd->notify_pos - asd->ring_read) > AUDIO_BLOCK_NOTIFY_LEAD) {
+				asd->notify = true;
+				break;
+			}
+			cas->cda_pending = false;
+			asd->notify = false;
+			if (cas->cda_next_cd_audio_buffer_callback) {
+				cas->cda_next_cd_audio_buffer_callback(cas->cda_userdata, cas->cb_data);
+				if (cas->cda_streamid != streamid)
+					return true;
+			}
+		}
+		if (cas->cda_length <= 0)
+			break;
+		int n = audio_write_stream_block(streamid, cas->cda_bufptr, cas->cda_length, NULL);
+		if (!n)
+			break;
+		cas->cda_bufptr += n * 2;
+		cas->cda_length -= n;
+		if (cas->cda_length <= 0 && cas->cda_next_cd_audio_buffer_callback) {
+			asd->notify_pos = asd->ring_write;
+			cas->cda_pending = true;
+		}
 	}
-	if (cas->cda_streamid <= 0)
+	if (cas->cda_bufptr >= dummy_buffer && cas->cda_bufptr <= dummy_buffer + 4 && !audio_stream_block_fill(streamid)) {
+		cas->cda_streamid = 0;
 		return false;
-	int samples[2];
-	samples[0] = cas->cda_bufptr[0] * cas->cda_volume[0] / 32768;
-	samples[1] = cas->cda_bufptr[1] * cas->cda_volume[1] / 32768;
-	audio_state_stream_state(streamid, samples, 2, cda_evt);
-	cas->cda_bufptr += 2;
-	cas->cda_length--;
-	if (cas->cda_length <= 0 && cas->cda_next_cd_audio_buffer_callback) {
-		cas->cda_next_cd_audio_buffer_callback(cas->cda_userdata, cas->cb_data);
 	}
 	return true;
 }
@@ -2997,10 +3427,14 @@ void audio_cda_new_buffer(struct cd_audio_state *cas, uae_s16 *buffer, int lengt
 		cas->cda_length = length;
 		cas->cda_userdata = userdata;
 		if (cas->cda_streamid <= 0)
-			cas->cda_streamid = audio_enable_stream(true, -1, 2, audio_state_cda, cas);
+			cas->cda_streamid = audio_enable_block_stream(2, cda_evt, audio_state_cda, cas);
 	}
 	cas->cda_next_cd_audio_buffer_callback = next_cd_audio_buffer_callback;
 	cas->cb_data = cb_data;
-	if (cas->cda_streamid > 0)
+	cas->cda_pending = false;
+	if (cas->cda_streamid > 0) {
+		audio_stream[cas->cda_streamid - 1].volume = cas->cda_volume;
+		audio_stream[cas->cda_streamid - 1].notify = false;
 		audio_activate();
+	}
 }
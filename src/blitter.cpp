@@ -503,6 +503,166 @@ static void blit_chipmem_agnus_wput(uaecptr addr, uae_u32 w, uae_u32 typemask)
 	}
 }
 
+/* Host pointer version of the generic fast blit loop below, used for fill
+ * blits and minterms without a generated blitfunc when every channel stays
+ * inside plain chip RAM. Word order, the delayed D write and all register
+ * side effects are the same as the generic loop. Only the memory accessors,
+ * the minterm switch and the fill tables are replaced: the minterm is
+ * computed from its eight product terms and fill uses a prefix XOR across
+ * the word. */
+
+STATIC_INLINE uae_u16 blit_minterm(uae_u32 a, uae_u32 b, uae_u32 c, uae_u8 mt)
+{
+	uae_u32 d = 0;
+	d |= (a & b & c) & (0 - ((mt >> 7) & 1));
+	d |= (a & b & ~c) & (0 - ((mt >> 6) & 1));
+	d |= (a & ~b & c) & (0 - ((mt >> 5) & 1));
+	d |= (a & ~b & ~c) & (0 - ((mt >> 4) & 1));
+	d |= (~a & b & c) & (0 - ((mt >> 3) & 1));
+	d |= (~a & b & ~c) & (0 - ((mt >> 2) & 1));
+	d |= (~a & ~b & c) & (0 - ((mt >> 1) & 1));
+	d |= (~a & ~b & ~c) & (0 - ((mt >> 0) & 1));
+	return (uae_u16)d;
+}
+
+STATIC_INLINE uae_u16 blit_fillword(uae_u16 d, int ife, int *fc)
+{
+	uae_u32 p = d;
+	// bit n of p = xor of bits 0..n
+	p ^= p << 1;
+	p ^= p << 2;
+	p ^= p << 4;
+	p ^= p << 8;
+	// fill state in front of each bit: carry in xor all edges to its right
+	uae_u32 f = ((p << 1) ^ (*fc ? 0xffff : 0)) & 0xffff;
+	*fc ^= (p >> 15) & 1;
+	return ife ? (d | f) : (d ^ f);
+}
+
+static bool blit_direct_range(uaecptr pt, int mod, bool desc)
+{
+	int h = blt_info.hblitsize;
+	int v = blt_info.vblitsize;
+	uae_s64 stride = h * 2 + mod;
+	uae_s64 first = pt, last;
+
+	if (pt & 1)
+		return false;
+	if (desc) {
+		last = (uae_s64)pt - stride * (v - 1);
+		uae_s64 hi = first > last ? first : last;
+		uae_s64 lo = (first < last ? first : last) - (h * 2 - 2);
+		return lo >= 0 && hi < (uae_s64)chipmem_full_size - 1 && hi <= chipmem_full_mask;
+	}
+	last = (uae_s64)pt + stride * (v - 1);
+	uae_s64 lo = first < last ? first : last;
+	uae_s64 hi = (first > last ? first : last) + (h * 2 - 2);
+	return lo >= 0 && hi < (uae_s64)chipmem_full_size - 1 && hi <= chipmem_full_mask;
+}
+
+static bool blitter_dofast_direct(bool desc, uaecptr bltadatptr, uaecptr bltbdatptr, uaecptr bltcdatptr, uaecptr bltddatptr)
+{
+	if (chipmem_wget_indirect != chipmem_agnus_wget || chipmem_wput_indirect != chipmem_agnus_wput)
+		return false;
+	if ((log_blitter & 4) || blit_dof)
+		return false;
+#ifdef DEBUGGER
+	if (memwatch_enabled)
+		return false;
+#endif
+	if ((bltadatptr && !blit_direct_range(bltadatptr, blt_info.bltamod, desc)) ||
+		(bltbdatptr && !blit_direct_range(bltbdatptr, blt_info.bltbmod, desc)) ||
+		(bltcdatptr && !blit_direct_range(bltcdatptr, blt_info.bltcmod, desc)) ||
+		(bltddatptr && !blit_direct_range(bltddatptr, blt_info.bltdmod, desc)))
+		return false;
+
+	uae_u8 *base = chipmem_bank.baseaddr;
+	uae_u16 *pa = bltadatptr ? (uae_u16 *)(base + bltadatptr) : NULL;
+	uae_u16 *pb = bltbdatptr ? (uae_u16 *)(base + bltbdatptr) : NULL;
+	uae_u16 *pc = bltcdatptr ? (uae_u16 *)(base + bltcdatptr) : NULL;
+	uae_u16 *pd = bltddatptr ? (uae_u16 *)(base + bltddatptr) : NULL;
+	int step = desc ? -1 : 1;
+	int amod = (desc ? -blt_info.bltamod : blt_info.bltamod) / 2;
+	int bmod = (desc ? -blt_info.bltbmod : blt_info.bltbmod) / 2;
+	int cmod = (desc ? -blt_info.bltcmod : blt_info.bltcmod) / 2;
+	int dmod = (desc ? -blt_info.bltdmod : blt_info.bltdmod) / 2;
+	int ashift = desc ? 16 - (bltcon0 >> 12) : bltcon0 >> 12;
+	int bshift = desc ? 16 - (bltcon1 >> 12) : bltcon1 >> 12;
+	uae_u8 mt = bltcon0 & 0xFF;
+	int ife = blitife;
+	int fill = blitfill;
+	int fc = blitfc;
+	uae_u32 blitbhold = blt_info.bltbhold;
+	uae_u16 *dstp = NULL;
+
+	for (int j = 0; j < blt_info.vblitsize; j++) {
+		fc = !!(bltcon1 & BLTFC);
+		for (int i = 0; i < blt_info.hblitsize; i++) {
+			uae_u32 bltadat, blitahold;
+			if (pa) {
+				blt_info.bltadat = bltadat = do_get_mem_word(pa);
+				pa += step;
+			} else {
+				bltadat = blt_info.bltadat;
+			}
+			bltadat &= blit_masktable[i];
+			if (desc)
+				blitahold = (((uae_u32)bltadat << 16) | blt_info.bltaold) >> ashift;
+			else
+				blitahold = (((uae_u32)blt_info.bltaold << 16) | bltadat) >> ashift;
+			blt_info.bltaold = bltadat;
+
+			if (pb) {
+				uae_u16 bltbdat = do_get_mem_word(pb);
+				pb += step;
+				if (desc)
+					blitbhold = (((uae_u32)bltbdat << 16) | blt_info.bltbold) >> bshift;
+				else
+					blitbhold = (((uae_u32)blt_info.bltbold << 16) | bltbdat) >> bshift;
+				blt_info.bltbold = bltbdat;
+				blt_info.bltbdat = bltbdat;
+			}
+
+			if (pc) {
+				blt_info.bltcdat = do_get_mem_word(pc);
+				if (desc)
+					blt_info.bltbdat = blt_info.bltcdat;
+				pc += step;
+			}
+			if (dstp)
+				do_put_mem_word(dstp, blt_info.bltddat);
+			uae_u16 d = blit_minterm(blitahold, blitbhold, blt_info.bltcdat, mt);
+			if (fill)
+				d = blit_fillword(d, ife, &fc);
+			blt_info.bltddat = d;
+			if (d)
+				blt_info.blitzero = 0;
+			if (pd) {
+				dstp = pd;
+				pd += step;
+			}
+		}
+		if (pa)
+			pa += amod;
+		if (pb)
+			pb += bmod;
+		if (pc)
+			pc += cmod;
+		if (pd)
+			pd += dmod;
+	}
+	if (dstp) {
+		do_put_mem_word(dstp, blt_info.bltddat);
+		regs.chipset_latch_rw = blt_info.bltddat;
+#ifdef DEBUGGER
+		debug_putpeekdma_chipram((uaecptr)((uae_u8 *)dstp - base), blt_info.bltddat, MW_MASK_BLITTER_D_N, 0x000, 0x054);
+#endif
+	}
+	blitfc = fc;
+	blt_info.bltbhold = blitbhold;
+	return true;
+}
+
 static void blitter_dofast (void)
 {
 	int i,j;
@@ -534,6 +694,8 @@ static void blitter_dofast (void)
 #if SPEEDUP
 	if (blitfunc_dofast[mt] && !blitfill) {
 		(*blitfunc_dofast[mt])(bltadatptr, bltbdatptr, bltcdatptr, bltddatptr, &blt_info);
+	} else if (blitter_dofast_direct(false, bltadatptr, bltbdatptr, bltcdatptr, bltddatptr)) {
+		;
 	} else
 #endif
 	{
@@ -635,6 +797,8 @@ static void blitter_dofast_desc (void)
 #if SPEEDUP
 	if (blitfunc_dofast_desc[mt] && !blitfill) {
 		(*blitfunc_dofast_desc[mt])(bltadatptr, bltbdatptr, bltcdatptr, bltddatptr, &blt_info);
+	} else if (blitter_dofast_direct(true, bltadatptr, bltbdatptr, bltcdatptr, bltddatptr)) {
+		;
 	} else
 #endif
 	{
@@ -12360,7 +12360,11 @@ static void vsync_handler_render(void)
 
 	bool frameok = framewait();
 	
+#ifdef AMIBERRY
+	if (!ad->picasso_on && !warp_present_skipped()) {
+#else
 	if (!ad->picasso_on) {
+#endif
 		if (!frame_rendered && vblank_hz_state) {
 			frame_rendered = crender_screen(0, 1, false);
 		}
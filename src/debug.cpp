@@ -244,6 +244,9 @@ static const TCHAR help[] = {
 	_T("                        Show DMA data (accurate only in cycle-exact mode).\n")
 	_T("                        v [-1 to -4] = enable visual DMA debugger.\n")
 	_T("  vh [<ratio> <lines>]  \"Heat map\"\n")
+	_T("  P [<rate>] [A<n>]     Start profiler, <rate> samples/s, call stacks from LINK An frames.\n")
+	_T("  Ps, Pc                Stop profiler, clear profiler data.\n")
+	_T("  Pr, Pw <file>         Show profile, write flat profile to <file> and stacks to <file>.folded.\n")
 	_T("  I <custom event>      Send custom event string\n")
 	_T("  ?<value>              Hex ($ and 0x)/Bin (%)/Dec (!) converter and calculator.\n")
 #ifdef _WIN32
@@ -741,7 +744,7 @@ uae_u32 returnregx(int regid)
 		case BREAKPOINT_REG_FPCR:
 		return regs.fpcr;
 		case BREAKPOINT_REG_FPSR:
-		return regs.fpsr;
+		return fpp_get_fpsr();
 	}
 	return 0;
 }
@@ -3328,9 +3331,84 @@ struct breakpoint_node bpnodes[BREAKPOINT_TOTAL];
 static addrbank **debug_mem_banks;
 static addrbank *debug_mem_area;
 struct memwatch_node mwnodes[MEMWATCH_TOTAL];
-static int mwnodes_start, mwnodes_end;
 static struct memwatch_node mwhit;
 
+/* Active watchpoints sorted by start address with the running maximum of
+ * their end addresses, and a bitmap of the pages they touch. Accesses to
+ * unwatched pages of a watched bank return after one bit test. */
+#define MEMWATCH_PAGE_SHIFT 12
+static int mwindex[MEMWATCH_TOTAL];
+static uae_u32 mwindex_maxend[MEMWATCH_TOTAL];
+static int mwindex_cnt;
+static uae_u8 *mwpages;
+
+STATIC_INLINE bool memwatch_page_hit (uaecptr addr, int size)
+{
+	uae_u32 p1 = addr >> MEMWATCH_PAGE_SHIFT;
+	uae_u32 p2 = (addr + size - 1) >> MEMWATCH_PAGE_SHIFT;
+	return mwpages && ((mwpages[p1 >> 3] & (1 << (p1 & 7))) || (mwpages[p2 >> 3] & (1 << (p2 & 7))));
+}
+
+/* Watchpoints overlapping addr..addr+size-1, in watchpoint number order. */
+static int memwatch_index_find (uaecptr addr, int size, int *nodes)
+{
+	uae_u32 last = addr + size - 1;
+	int lo = 0, hi = mwindex_cnt - 1, k = -1;
+	int cnt = 0;
+
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (mwnodes[mwindex[mid]].addr <= last) {
+			k = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	for (; k >= 0 && mwindex_maxend[k] > addr; k--) {
+		struct memwatch_node *m = &mwnodes[mwindex[k]];
+		if (m->addr + m->size > addr) {
+			int n = mwindex[k];
+			int j = cnt++;
+			while (j > 0 && nodes[j - 1] > n) {
+				nodes[j] = nodes[j - 1];
+				j--;
+			}
+			nodes[j] = n;
+		}
+	}
+	return cnt;
+}
+
+static void memwatch_index_build (void)
+{
+	mwindex_cnt = 0;
+	if (mwpages)
+		memset (mwpages, 0, (1 << (32 - MEMWATCH_PAGE_SHIFT)) / 8);
+	for (int i = 0; i < MEMWATCH_TOTAL; i++) {
+		struct memwatch_node *m = &mwnodes[i];
+		if (!m->size)
+			continue;
+		int j = mwindex_cnt++;
+		while (j > 0 && mwnodes[mwindex[j - 1]].addr > m->addr) {
+			mwindex[j] = mwindex[j - 1];
+			j--;
+		}
+		mwindex[j] = i;
+		if (mwpages) {
+			uae_u32 p1 = m->addr >> MEMWATCH_PAGE_SHIFT;
+			uae_u32 p2 = (m->addr + m->size - 1) >> MEMWATCH_PAGE_SHIFT;
+			for (uae_u32 p = p1; p <= p2; p++)
+				mwpages[p >> 3] |= 1 << (p & 7);
+		}
+	}
+	for (int j = 0; j < mwindex_cnt; j++) {
+		struct memwatch_node *m = &mwnodes[mwindex[j]];
+		uae_u32 end = m->addr + m->size;
+		mwindex_maxend[j] = j > 0 && mwindex_maxend[j - 1] > end ? mwindex_maxend[j - 1] : end;
+	}
+}
+
 #define MUNGWALL_SLOTS 16
 struct mungwall_data
 {
@@ -3633,7 +3711,7 @@ uae_u8 *save_debug_memwatch (size_t *len, uae_u8 *dstptr)
 	if (dstptr)
 		dstbak = dst = dstptr;
 	else
-		dstbak = dst = xmalloc (uae_u8, 1000);
+		dstbak = dst = xmalloc (uae_u8, 100 + total * 100);
 	save_u32 (1);
 	save_u8 (total);
 	for (int i = 0; i < MEMWATCH_TOTAL; i++) {
@@ -3834,169 +3912,184 @@ static void memwatch_hit_msg(int mw)
 	}
 }
 
-static int memwatch_func (uaecptr addr, int rwi, int size, uae_u32 *valp, uae_u32 accessmask, uae_u32 reg)
+/* Check one watchpoint against an access, -1 if it doesn't apply,
+ * otherwise the memwatch_func() result. */
+static int memwatch_node_check (int i, uaecptr addr, int rwi, int size, uae_u32 *valp, uae_u32 accessmask, uae_u32 reg)
 {
 	uae_u32 val = *valp;
+	struct memwatch_node *m = &mwnodes[i];
+	uaecptr addr2 = m->addr;
+	uaecptr addr3 = addr2 + m->size;
+	int rwi2 = m->rwi;
+	uae_u32 oldval = 0;
+	int isoldval = 0;
+	int brk = 0;
+
+	if (m->size == 0)
+		return -1;
+	if (!(rwi & rwi2))
+		return -1;
+	if (!(m->access_mask & accessmask))
+		return -1;
 
-	if (inside_debugger)
-		return 1;
+	if (addr >= addr2 && addr < addr3)
+		brk = 1;
+	if (!brk && size == 2 && (addr + 1 >= addr2 && addr + 1 < addr3))
+		brk = 1;
+	if (!brk && size == 4 && ((addr + 2 >= addr2 && addr + 2 < addr3) || (addr + 3 >= addr2 && addr + 3 < addr3)))
+		brk = 1;
 
-	if (mungwall)
-		mungwall_memwatch(addr, rwi, size, val);
+	if (!brk)
+		return -1;
 
-	if (illgdebug)
-		illg_debug_do (addr, rwi, size, val);
+	if (m->bus_error) {
+		if (((m->bus_error & 1) && (rwi & 1)) || ((m->bus_error & 4) && (rwi & 4)) || ((m->bus_error & 2) && (rwi & 2))) {
+			hardware_exception2(addr, val, (rwi & 2) != 0, (rwi & 4) != 0, size == 4 ? sz_long : (size == 2 ? sz_word : sz_byte));
+		}
+		return -1;
+	}
 
-	if (heatmap)
-		memwatch_heatmap (addr, rwi, size, accessmask);
+	if (mem_banks[addr >> 16]->check (addr, size)) {
+		uae_u8 *p = mem_banks[addr >> 16]->xlateaddr (addr);
+		if (size == 1)
+			oldval = p[0];
+		else if (size == 2)
+			oldval = (p[0] << 8) | p[1];
+		else
+			oldval = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | (p[3] << 0);
+		isoldval = 1;
+	}
 
-	addr = munge24 (addr);
+	if (m->pc != 0xffffffff) {
+		if (m->pc != regs.instruction_pc)
+			return -1;
+	}
 
-	if (smc_table && (rwi >= 2))
-		smc_detector (addr, rwi, size, valp);
+	if (!m->frozen && m->val_enabled) {
+		int trigger = 0;
+		uae_u32 mask = m->size == 4 ? 0xffffffff : (1 << (m->size * 8)) - 1;
+		uae_u32 mval = m->val;
+		int scnt = size;
+		for (;;) {
+			if (((mval & mask) & m->val_mask) == ((val & mask) & m->val_mask))
+				trigger = 1;
+			if (mask & 0x80000000)
+				break;
+			if (m->size == 1) {
+				mask <<= 8;
+				mval <<= 8;
+				scnt--;
+			} else if (m->size == 2) {
+				mask <<= 16;
+				scnt -= 2;
+				mval <<= 16;
+			} else {
+				scnt -= 4;
+			}
+			if (scnt <= 0)
+				break;
+		}
+		if (!trigger)
+			return -1;
+	}
 
-	for (int i = mwnodes_start; i <= mwnodes_end; i++) {
-		struct memwatch_node *m = &mwnodes[i];
-		uaecptr addr2 = m->addr;
-		uaecptr addr3 = addr2 + m->size;
-		int rwi2 = m->rwi;
-		uae_u32 oldval = 0;
-		int isoldval = 0;
-		int brk = 0;
-
-		if (m->size == 0)
-			continue;
-		if (!(rwi & rwi2))
-			continue;
-		if (!(m->access_mask & accessmask))
-			continue;
+	if (m->mustchange && rwi == 2 && isoldval) {
+		if (oldval == *valp)
+			return -1;
+	}
 
-		if (addr >= addr2 && addr < addr3)
-			brk = 1;
-		if (!brk && size == 2 && (addr + 1 >= addr2 && addr + 1 < addr3))
-			brk = 1;
-		if (!brk && size == 4 && ((addr + 2 >= addr2 && addr + 2 < addr3) || (addr + 3 >= addr2 && addr + 3 < addr3)))
-			brk = 1;
+	if (m->modval_written) {
+		if (!rwi) {
+			brk = 0;
+		} else if (m->modval_written == 1) {
+			m->modval_written = 2;
+			m->modval = val;
+			brk = 0;
+		} else if (m->modval == val) {
+			brk = 0;
+		}
+	}
+	if (m->frozen) {
+		if (m->val_enabled) {
+			int shift = (addr + size - 1) - (m->addr + m->val_size - 1);
+			uae_u32 sval;
+			uae_u32 mask;
 
-		if (!brk)
-			continue;
+			if (m->val_size == 4)
+				mask = 0xffffffff;
+			else if (m->val_size == 2)
+				mask = 0x0000ffff;
+			else
+				mask = 0x000000ff;
 
-		if (m->bus_error) {
-			if (((m->bus_error & 1) && (rwi & 1)) || ((m->bus_error & 4) && (rwi & 4)) || ((m->bus_error & 2) && (rwi & 2))) {
-				hardware_exception2(addr, val, (rwi & 2) != 0, (rwi & 4) != 0, size == 4 ? sz_long : (size == 2 ? sz_word : sz_byte));
+			sval = m->val;
+			if (shift < 0) {
+				shift = -8 * shift;
+				sval >>= shift;
+				mask >>= shift;
+			} else {
+				shift = 8 * shift;
+				sval <<= shift;
+				mask <<= shift;
 			}
-			continue;
+			*valp = (sval & mask) | ((*valp) & ~mask);
+			//write_log (_T("%08x %08x %08x %08x %d\n"), addr, m->addr, *valp, mask, shift);
+			return 1;
 		}
+		return 0;
+	}
+	mwhit.addr = addr;
+	mwhit.rwi = rwi;
+	mwhit.size = size;
+	mwhit.val = 0;
+	mwhit.access_mask = accessmask;
+	mwhit.reg = reg;
+	if (mwhit.rwi & 2)
+		mwhit.val = val;
+	mwhit.pc = M68K_GETPC;
+	memwatch_triggered = i + 1;
+	if (m->reportonly) {
+		memwatch_hit_msg(memwatch_triggered - 1);
+	}
+	if (!m->nobreak && !m->reportonly) {
+		debugging = 1;
+		debug_pc = M68K_GETPC;
+		debug_cycles(1);
+		set_special(SPCFLAG_BRK);
+	}
+	return 1;
+}
 
-		if (mem_banks[addr >> 16]->check (addr, size)) {
-			uae_u8 *p = mem_banks[addr >> 16]->xlateaddr (addr);
-			if (size == 1)
-				oldval = p[0];
-			else if (size == 2)
-				oldval = (p[0] << 8) | p[1];
-			else
-				oldval = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | (p[3] << 0);
-			isoldval = 1;
-		}
+static int memwatch_func (uaecptr addr, int rwi, int size, uae_u32 *valp, uae_u32 accessmask, uae_u32 reg)
+{
+	uae_u32 val = *valp;
 
-		if (m->pc != 0xffffffff) {
-			if (m->pc != regs.instruction_pc)
-				continue;
-		}
+	if (inside_debugger)
+		return 1;
 
-		if (!m->frozen && m->val_enabled) {
-			int trigger = 0;
-			uae_u32 mask = m->size == 4 ? 0xffffffff : (1 << (m->size * 8)) - 1;
-			uae_u32 mval = m->val;
-			int scnt = size;
-			for (;;) {
-				if (((mval & mask) & m->val_mask) == ((val & mask) & m->val_mask))
-					trigger = 1;
-				if (mask & 0x80000000)
-					break;
-				if (m->size == 1) {
-					mask <<= 8;
-					mval <<= 8;
-					scnt--;
-				} else if (m->size == 2) {
-					mask <<= 16;
-					scnt -= 2;
-					mval <<= 16;
-				} else {
-					scnt -= 4;
-				}
-				if (scnt <= 0)
-					break;
-			}
-			if (!trigger)
-				continue;
-		}
+	if (mungwall)
+		mungwall_memwatch(addr, rwi, size, val);
 
-		if (m->mustchange && rwi == 2 && isoldval) {
-			if (oldval == *valp)
-				continue;
-		}
+	if (illgdebug)
+		illg_debug_do (addr, rwi, size, val);
 
-		if (m->modval_written) {
-			if (!rwi) {
-				brk = 0;
-			} else if (m->modval_written == 1) {
-				m->modval_written = 2;
-				m->modval = val;
-				brk = 0;
-			} else if (m->modval == val) {
-				brk = 0;
-			}
-		}
-		if (m->frozen) {
-			if (m->val_enabled) {
-				int shift = (addr + size - 1) - (m->addr + m->val_size - 1);
-				uae_u32 sval;
-				uae_u32 mask;
+	if (heatmap)
+		memwatch_heatmap (addr, rwi, size, accessmask);
 
-				if (m->val_size == 4)
-					mask = 0xffffffff;
-				else if (m->val_size == 2)
-					mask = 0x0000ffff;
-				else
-					mask = 0x000000ff;
+	addr = munge24 (addr);
 
-				sval = m->val;
-				if (shift < 0) {
-					shift = -8 * shift;
-					sval >>= shift;
-					mask >>= shift;
-				} else {
-					shift = 8 * shift;
-					sval <<= shift;
-					mask <<= shift;
-				}
-				*valp = (sval & mask) | ((*valp) & ~mask);
-				//write_log (_T("%08x %08x %08x %08x %d\n"), addr, m->addr, *valp, mask, shift);
-				return 1;
-			}
-			return 0;
-		}
-		mwhit.addr = addr;
-		mwhit.rwi = rwi;
-		mwhit.size = size;
-		mwhit.val = 0;
-		mwhit.access_mask = accessmask;
-		mwhit.reg = reg;
-		if (mwhit.rwi & 2)
-			mwhit.val = val;
-		mwhit.pc = M68K_GETPC;
-		memwatch_triggered = i + 1;
-		if (m->reportonly) {
-			memwatch_hit_msg(memwatch_triggered - 1);
-		}
-		if (!m->nobreak && !m->reportonly) {
-			debugging = 1;
-			debug_pc = M68K_GETPC;
-			debug_cycles(1);
-			set_special(SPCFLAG_BRK);
-		}
+	if (smc_table && (rwi >= 2))
+		smc_detector (addr, rwi, size, valp);
+
+	if (!memwatch_page_hit (addr, size))
 		return 1;
+
+	int nodes[MEMWATCH_TOTAL];
+	int cnt = memwatch_index_find (addr, size, nodes);
+	for (int j = 0; j < cnt; j++) {
+		int v = memwatch_node_check (nodes[j], addr, rwi, size, valp, accessmask, reg);
+		if (v >= 0)
+			return v;
 	}
 	return 1;
 }
@@ -4339,16 +4432,11 @@ static void memwatch_remap (uaecptr addr)
 static void memwatch_setup(void)
 {
 	memwatch_reset();
-	mwnodes_start = MEMWATCH_TOTAL - 1;
-	mwnodes_end = 0;
+	memwatch_index_build();
 	for (int i = 0; i < MEMWATCH_TOTAL; i++) {
 		struct memwatch_node *m = &mwnodes[i];
 		if (!m->size)
 			continue;
-		if (mwnodes_start > i)
-			mwnodes_start = i;
-		if (mwnodes_end < i)
-			mwnodes_end = i;
 		int addr = m->addr & ~65535;
 		int eaddr = (m->addr + m->size + 65535) & ~65535;
 		while (addr < eaddr) {
@@ -4372,6 +4460,9 @@ static int deinitialize_memwatch (void)
 	debug_mem_area = NULL;
 	xfree (membank_stores);
 	membank_stores = NULL;
+	xfree (mwpages);
+	mwpages = NULL;
+	mwindex_cnt = 0;
 	memwatch_enabled = 0;
 	mmu_enabled = 0;
 	xfree (illgdebug);
@@ -4393,6 +4484,7 @@ static void initialize_memwatch (int mode)
 	}
 	debug_mem_area = xcalloc (addrbank, membank_total);
 	membank_stores = xcalloc (struct membank_store, MEMWATCH_STORE_SLOTS);
+	mwpages = xcalloc (uae_u8, (1 << (32 - MEMWATCH_PAGE_SHIFT)) / 8);
 	for (int i = 0; i < MEMWATCH_TOTAL; i++) {
 		struct memwatch_node *m = &mwnodes[i];
 		m->pc = 0xffffffff;
@@ -5589,8 +5681,367 @@ static void breakfunc(uae_u32 v)
 	set_special(SPCFLAG_BRK);
 }
 
+/* Statistical profiler. An event2 timer samples the PC and optionally the
+ * return addresses of the frame pointer chain at a fixed average rate,
+ * samples are aggregated per unique call stack. Nothing runs when it is
+ * not enabled. */
+#define PROFILER_DEPTH 16
+#define PROFILER_HASH (1 << 16)
+#define PROFILER_NAME 64
+
+struct profiler_stack
+{
+	uae_u32 count;
+	int depth;
+	uaecptr pc[PROFILER_DEPTH];
+};
+static struct profiler_stack *profiler_stacks;
+static bool profiler_active;
+static int profiler_used, profiler_framereg = -1;
+static uae_u32 profiler_interval, profiler_seed;
+static uae_u32 profiler_samples, profiler_lost;
+static evt_t profiler_last;
+
+static void profiler_add(const uaecptr *pc, int depth)
+{
+	uae_u32 hash = 2166136261u;
+	for (int i = 0; i < depth; i++)
+		hash = (hash ^ pc[i]) * 16777619u;
+	profiler_samples++;
+	for (int i = 0; i < PROFILER_HASH; i++) {
+		struct profiler_stack *ps = &profiler_stacks[(hash + i) & (PROFILER_HASH - 1)];
+		if (!ps->count) {
+			// keep some room so that probing stays short
+			if (profiler_used >= PROFILER_HASH - PROFILER_HASH / 8)
+				break;
+			ps->depth = depth;
+			memcpy(ps->pc, pc, depth * sizeof(uaecptr));
+			ps->count = 1;
+			profiler_used++;
+			return;
+		}
+		if (ps->depth == depth && !memcmp(ps->pc, pc, depth * sizeof(uaecptr))) {
+			ps->count++;
+			return;
+		}
+	}
+	profiler_lost++;
+}
+
+static void profiler_sample(uae_u32 v)
+{
+	uaecptr pc[PROFILER_DEPTH];
+	int depth = 0;
+
+	if (!profiler_active)
+		return;
+	pc[depth++] = m68k_getpc();
+	if (profiler_framereg >= 0) {
+		// LINK An frames: old An at (An), return address at 4(An)
+		uaecptr fp = m68k_areg(regs, profiler_framereg);
+		while (depth < PROFILER_DEPTH && fp && !(fp & 1) && valid_address(fp, 8)) {
+			uaecptr next = get_long_debug(fp);
+			uaecptr ret = get_long_debug(fp + 4);
+			if (!ret || (ret & 1))
+				break;
+			pc[depth++] = ret;
+			if (next <= fp)
+				break;
+			fp = next;
+		}
+	}
+	profiler_add(pc, depth);
+	profiler_last = get_cycles();
+	// +-25% jitter, don't lock to code that is synchronized to the beam
+	profiler_seed = profiler_seed * 1103515245 + 12345;
+	uae_u32 next = profiler_interval - profiler_interval / 4 + (profiler_seed >> 8) % (profiler_interval / 2 + 1);
+	event2_newevent_x(-1, next, 0, profiler_sample);
+}
+
+static void profiler_start(int rate, int framereg)
+{
+	if (!profiler_stacks)
+		profiler_stacks = xcalloc(struct profiler_stack, PROFILER_HASH);
+	if (rate <= 0)
+		rate = 1000;
+	profiler_interval = (uae_u32)(maxhpos * maxvpos * vblank_hz / rate);
+	if (profiler_interval < 4)
+		profiler_interval = 4;
+	profiler_framereg = framereg;
+	profiler_seed = (uae_u32)get_cycles();
+	bool wasactive = profiler_active;
+	profiler_active = true;
+	if (!wasactive)
+		profiler_sample(0);
+	console_out_f(_T("Profiler started, %d samples/s"), rate);
+	if (framereg >= 0)
+		console_out_f(_T(", call stacks from A%d frames"), framereg);
+	console_out_f(_T(".\n"));
+}
+
+/* Restart sampling if a reset cleared the pending event. */
+static void profiler_hsync(void)
+{
+	if (profiler_active && get_cycles() - profiler_last > (evt_t)profiler_interval * 4 * CYCLE_UNIT) {
+		event2_newevent_x_remove(profiler_sample);
+		profiler_sample(0);
+	}
+}
+
+struct profiler_addr
+{
+	uaecptr pc, base;
+	int func;
+	TCHAR name[PROFILER_NAME];
+};
+struct profiler_func
+{
+	uaecptr base, hotpc;
+	const TCHAR *name;
+	uae_u32 self, incl, hot, last;
+};
+static struct profiler_addr *profiler_addrs;
+static struct profiler_func *profiler_funcs;
+static int profiler_addrcnt, profiler_funccnt;
+
+static int profiler_pc_cmp(const void *a, const void *b)
+{
+	uaecptr v1 = *(const uaecptr*)a;
+	uaecptr v2 = *(const uaecptr*)b;
+	return v1 < v2 ? -1 : v1 > v2 ? 1 : 0;
+}
+static int profiler_addr_func_cmp(const void *a, const void *b)
+{
+	const struct profiler_addr *a1 = *(const struct profiler_addr**)a;
+	const struct profiler_addr *a2 = *(const struct profiler_addr**)b;
+	if (a1->base != a2->base)
+		return a1->base < a2->base ? -1 : 1;
+	return _tcscmp(a1->name, a2->name);
+}
+static int profiler_func_self_cmp(const void *a, const void *b)
+{
+	const struct profiler_func *f1 = (const struct profiler_func*)a;
+	const struct profiler_func *f2 = (const struct profiler_func*)b;
+	if (f1->self != f2->self)
+		return f1->self > f2->self ? -1 : 1;
+	return f1->incl > f2->incl ? -1 : f1->incl < f2->incl ? 1 : 0;
+}
+
+static struct profiler_addr *profiler_find(uaecptr pc)
+{
+	int lo = 0, hi = profiler_addrcnt - 1;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (profiler_addrs[mid].pc == pc)
+			return &profiler_addrs[mid];
+		if (profiler_addrs[mid].pc < pc)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return NULL;
+}
+
+/* Resolve every sampled address once, then build self and inclusive
+ * counts per function. */
+static bool profiler_resolve(void)
+{
+	int total = 0;
+	for (int i = 0; i < PROFILER_HASH; i++)
+		total += profiler_stacks[i].count ? profiler_stacks[i].depth : 0;
+	if (!total)
+		return false;
+	uaecptr *pcs = xmalloc(uaecptr, total);
+	int n = 0;
+	for (int i = 0; i < PROFILER_HASH; i++) {
+		struct profiler_stack *ps = &profiler_stacks[i];
+		if (ps->count) {
+			for (int j = 0; j < ps->depth; j++)
+				pcs[n++] = ps->pc[j];
+		}
+	}
+	qsort(pcs, n, sizeof(uaecptr), profiler_pc_cmp);
+	profiler_addrs = xcalloc(struct profiler_addr, n);
+	profiler_addrcnt = 0;
+	debugmem_symbol_index(true);
+	for (int i = 0; i < n; i++) {
+		if (i > 0 && pcs[i] == pcs[i - 1])
+			continue;
+		struct profiler_addr *pa = &profiler_addrs[profiler_addrcnt++];
+		pa->pc = pcs[i];
+		if (!debugmem_get_symbol_nearest(pa->pc, pa->name, PROFILER_NAME, &pa->base)) {
+			pa->base = pa->pc;
+			_stprintf(pa->name, _T("$%08x"), pa->pc);
+		}
+	}
+	debugmem_symbol_index(false);
+	xfree(pcs);
+
+	struct profiler_addr **sorted = xmalloc(struct profiler_addr*, profiler_addrcnt);
+	for (int i = 0; i < profiler_addrcnt; i++)
+		sorted[i] = &profiler_addrs[i];
+	qsort(sorted, profiler_addrcnt, sizeof(struct profiler_addr*), profiler_addr_func_cmp);
+	profiler_funcs = xcalloc(struct profiler_func, profiler_addrcnt);
+	profiler_funccnt = 0;
+	for (int i = 0; i < profiler_addrcnt; i++) {
+		if (!i || profiler_addr_func_cmp(&sorted[i], &sorted[i - 1])) {
+			struct profiler_func *pf = &profiler_funcs[profiler_funccnt++];
+			pf->base = sorted[i]->base;
+			pf->name = sorted[i]->name;
+		}
+		sorted[i]->func = profiler_funccnt - 1;
+	}
+	xfree(sorted);
+
+	for (int i = 0; i < PROFILER_HASH; i++) {
+		struct profiler_stack *ps = &profiler_stacks[i];
+		if (!ps->count)
+			continue;
+		for (int j = 0; j < ps->depth; j++) {
+			struct profiler_func *pf = &profiler_funcs[profiler_find(ps->pc[j])->func];
+			if (!j)
+				pf->self += ps->count;
+			// recursion counts once per stack
+			if (pf->last != i + 1) {
+				pf->incl += ps->count;
+				pf->last = i + 1;
+			}
+		}
+	}
+	// hottest address in each function
+	for (int i = 0; i < PROFILER_HASH; i++) {
+		struct profiler_stack *ps = &profiler_stacks[i];
+		if (!ps->count)
+			continue;
+		struct profiler_func *pf = &profiler_funcs[profiler_find(ps->pc[0])->func];
+		if (ps->count > pf->hot) {
+			pf->hot = ps->count;
+			pf->hotpc = ps->pc[0];
+		}
+	}
+	qsort(profiler_funcs, profiler_funccnt, sizeof(struct profiler_func), profiler_func_self_cmp);
+	return true;
+}
+
+static void profiler_free(void)
+{
+	xfree(profiler_addrs);
+	xfree(profiler_funcs);
+	profiler_addrs = NULL;
+	profiler_funcs = NULL;
+	profiler_addrcnt = profiler_funccnt = 0;
+}
+
+static void profiler_flat(FILE *f, int maxlines)
+{
+	TCHAR txt[256];
+	double total = profiler_samples - profiler_lost;
+	_stprintf(txt, _T("%u samples, %u lost, %d stacks\n  self%%  total%%  samples  function (hottest address)\n"), profiler_samples, profiler_lost, profiler_used);
+	if (f)
+		fputs(txt, f);
+	else
+		console_out(txt);
+	for (int i = 0; i < profiler_funccnt && (maxlines <= 0 || i < maxlines); i++) {
+		struct profiler_func *pf = &profiler_funcs[i];
+		int line = debugmem_get_sourceline(pf->hotpc, NULL, 0);
+		TCHAR lt[32];
+		lt[0] = 0;
+		if (line > 0)
+			_stprintf(lt, _T(" line %d"), line);
+		_stprintf(txt, _T("%6.2f %7.2f %8u  %s ($%08x%s)\n"),
+			pf->self * 100.0 / total, pf->incl * 100.0 / total, pf->self, pf->name, pf->hotpc, lt);
+		if (f)
+			fputs(txt, f);
+		else
+			console_out(txt);
+	}
+}
+
+/* One line per unique stack, outermost caller first, "a;b;c count".
+ * This is the folded format flame graph tools read. */
+static void profiler_folded(FILE *f)
+{
+	for (int i = 0; i < PROFILER_HASH; i++) {
+		struct profiler_stack *ps = &profiler_stacks[i];
+		if (!ps->count)
+			continue;
+		for (int j = ps->depth - 1; j >= 0; j--) {
+			struct profiler_addr *pa = profiler_find(ps->pc[j]);
+			fprintf(f, "%s%s", pa->name, j ? ";" : "");
+		}
+		fprintf(f, " %u\n", ps->count);
+	}
+}
+
+static void profiler_report(const TCHAR *name)
+{
+	if (!profiler_stacks || !profiler_resolve()) {
+		console_out(_T("No profiler samples.\n"));
+		return;
+	}
+	if (!name) {
+		profiler_flat(NULL, 30);
+	} else {
+		TCHAR fname[MAX_DPATH];
+		FILE *f = uae_tfopen(name, _T("w"));
+		if (f) {
+			profiler_flat(f, 0);
+			fclose(f);
+		}
+		_stprintf(fname, _T("%s.folded"), name);
+		FILE *f2 = uae_tfopen(fname, _T("w"));
+		if (f2) {
+			profiler_folded(f2);
+			fclose(f2);
+		}
+		if (f && f2)
+			console_out_f(_T("Profile written to '%s' and '%s'.\n"), name, fname);
+		else
+			console_out_f(_T("Couldn't write '%s'.\n"), f ? fname : name);
+	}
+	profiler_free();
+}
+
+static void profiler_cmd(TCHAR **c)
+{
+	TCHAR cmd = **c;
+	if (cmd == 's') {
+		profiler_active = false;
+		event2_newevent_x_remove(profiler_sample);
+		console_out(_T("Profiler stopped.\n"));
+	} else if (cmd == 'c') {
+		if (profiler_stacks)
+			memset(profiler_stacks, 0, sizeof(struct profiler_stack) * PROFILER_HASH);
+		profiler_used = 0;
+		profiler_samples = profiler_lost = 0;
+		console_out(_T("Profiler data cleared.\n"));
+	} else if (cmd == 'r') {
+		next_char(c);
+		profiler_report(NULL);
+	} else if (cmd == 'w') {
+		next_char(c);
+		ignore_ws(c);
+		if (!**c) {
+			console_out(_T("Pw <file>\n"));
+			return;
+		}
+		profiler_report(*c);
+	} else {
+		int rate = 0, framereg = -1;
+		if (more_params(c))
+			rate = readint(c, NULL);
+		if (more_params(c)) {
+			if (_totupper(**c) == 'A')
+				next_char(c);
+			framereg = readint(c, NULL) & 7;
+		}
+		profiler_start(rate, framereg);
+	}
+}
+
 void debug_hsync(void)
 {
+	profiler_hsync();
 	if (debug_vpos < 0) {
 		return;
 	}
@@ -6632,6 +7083,7 @@ static bool debug_line (TCHAR *input)
 		case 'C': cheatsearch (&inptr); break;
 		case 'W': writeintomem (&inptr); break;
 		case 'w': memwatch (&inptr); break;
+		case 'P': profiler_cmd (&inptr); break;
 		case 'S': saveloadmem (&inptr, true); break;
 		case 'L': saveloadmem (&inptr, false); break;
 		case 's':
@@ -3695,6 +3695,81 @@ int debugmem_get_symbol(uaecptr addr, TCHAR *out, int maxsize)
 	return found;
 }
 
+/* Address sorted symbol index for nearest symbol lookups, only valid
+ * between debugmem_symbol_index(true) and debugmem_symbol_index(false). */
+static struct debugsymbol **symbols_sorted;
+static int symbols_sorted_cnt;
+
+static int debugmem_symbol_cmp(const void *a, const void *b)
+{
+	const struct debugsymbol *s1 = *(const struct debugsymbol**)a;
+	const struct debugsymbol *s2 = *(const struct debugsymbol**)b;
+	if (s1->value < s2->value)
+		return -1;
+	if (s1->value > s2->value)
+		return 1;
+	// prefer functions over labels at the same address
+	return (int)s2->type - (int)s1->type;
+}
+
+void debugmem_symbol_index(bool build)
+{
+	xfree(symbols_sorted);
+	symbols_sorted = NULL;
+	symbols_sorted_cnt = 0;
+	if (!build || !symbols)
+		return;
+	symbols_sorted = xmalloc(struct debugsymbol*, MAX_DEBUGSYMS);
+	for (int i = 0; i < MAX_DEBUGSYMS; i++) {
+		struct debugsymbol *ds = symbols[i];
+		if (ds->allocid && ds->name)
+			symbols_sorted[symbols_sorted_cnt++] = ds;
+	}
+	qsort(symbols_sorted, symbols_sorted_cnt, sizeof(struct debugsymbol*), debugmem_symbol_cmp);
+}
+
+/* Closest symbol at or below addr in the same segment, at most 64k away.
+ * Returns true and the symbol address in basep if found. */
+bool debugmem_get_symbol_nearest(uaecptr addr, TCHAR *out, int maxsize, uaecptr *basep)
+{
+	struct debugmemallocs *alloc = ismysegment(addr);
+	struct debugsymbol *best = NULL;
+	if (symbols_sorted) {
+		int lo = 0, hi = symbols_sorted_cnt - 1, idx = -1;
+		while (lo <= hi) {
+			int mid = (lo + hi) / 2;
+			if (symbols_sorted[mid]->value <= addr) {
+				idx = mid;
+				lo = mid + 1;
+			} else {
+				hi = mid - 1;
+			}
+		}
+		// first entry of equal addresses is the preferred one
+		while (idx > 0 && symbols_sorted[idx - 1]->value == symbols_sorted[idx]->value)
+			idx--;
+		if (idx >= 0)
+			best = symbols_sorted[idx];
+	} else {
+		for (int i = 0; i < symbolcnt; i++) {
+			struct debugsymbol *ds = symbols[i];
+			if (ds->allocid && ds->name && ds->value <= addr && (!best || ds->value > best->value))
+				best = ds;
+		}
+	}
+	if (!best || addr - best->value >= 0x10000)
+		return false;
+	if (alloc && best->section && best->section != alloc)
+		return false;
+	if (out) {
+		_tcsncpy(out, best->name, maxsize - 1);
+		out[maxsize - 1] = 0;
+	}
+	if (basep)
+		*basep = best->value;
+	return true;
+}
+
 struct debugcodefile *last_codefile;
 
 int debugmem_get_sourceline(uaecptr addr, TCHAR *out, int maxsize)
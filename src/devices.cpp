@@ -278,6 +278,7 @@ void devices_vsync_pre(void)
 	sampler_vsync();
 	clipboard_vsync();
 	statusline_vsync();
+	uae_thread_telemetry_vsync();
 
 	execute_device_items(device_vsyncs_pre, device_vsync_pre_cnt);
 }
@@ -176,6 +176,17 @@ typedef struct {
 
 #define MAXMFMBUF (0x4000 * DDHDMULT)
 
+/* Decoded copy of one track, see trackcache_get() */
+struct trackcache {
+	uae_u16 *mfm;
+	uae_u16 *timing;
+	int tracklen;
+	int skipoffset;
+	int indexoffset;
+	int writelen;
+	int generation;
+};
+
 typedef enum { ADF_NONE = -1, ADF_NORMAL, ADF_EXT1, ADF_EXT2, ADF_FDI, ADF_IPF, ADF_SCP, ADF_CATWEASEL, ADF_PCDOS, ADF_KICK, ADF_SKICK, ADF_NORMAL_HEADER, ADF_FLOPPYBRIDGE } drive_filetype;
 typedef struct {
 	int drvnum;
@@ -243,6 +254,8 @@ typedef struct {
 	FloppyDiskBridge *bridge;
 	bool writepending;
 #endif
+	struct trackcache trackcache[MAX_TRACKS];
+	int trackcache_generation;
 } drive;
 
 #define MIN_STEPLIMIT_CYCLE (CYCLE_UNIT * 140)
@@ -765,6 +778,92 @@ static void drive_settype_id (drive *drv)
 #endif
 }
 
+/* Decoded tracks are kept per drive so that trackloaders seeking back and
+ * forth do not re-run the MFM encoder or the IPF decoder on every step.
+ * Only decodes that give the same result every time are cached: sector
+ * images, raw ADF tracks and IPF tracks without flakey bits loaded fresh
+ * after a seek. Any write to the drive bumps the generation and so
+ * invalidates everything. */
+static void trackcache_free(drive *drv)
+{
+	for (int i = 0; i < MAX_TRACKS; i++) {
+		struct trackcache *tc = &drv->trackcache[i];
+		xfree(tc->mfm);
+		xfree(tc->timing);
+		tc->mfm = NULL;
+		tc->timing = NULL;
+	}
+	drv->trackcache_generation++;
+}
+
+static bool trackcache_usable(drive *drv, int tr, bool retrytrack)
+{
+	if (tr >= MAX_TRACKS)
+		return false;
+	if (drv->writediskfile && drv->writetrackdata[tr].bitlen > 0)
+		return false;
+	switch (drv->filetype)
+	{
+	case ADF_IPF:
+		// a retry continues from the current revolution
+		return !retrytrack;
+	case ADF_SCP:
+	case ADF_FDI:
+	case ADF_CATWEASEL:
+	case ADF_FLOPPYBRIDGE:
+		return false;
+	default:
+		return drv->trackdata[tr].type != TRACK_NONE;
+	}
+}
+
+static bool trackcache_get(drive *drv, int tr, bool retrytrack)
+{
+	if (!trackcache_usable(drv, tr, retrytrack))
+		return false;
+	struct trackcache *tc = &drv->trackcache[tr];
+	if (!tc->mfm || tc->generation != drv->trackcache_generation || tc->writelen != FLOPPY_WRITE_LEN)
+		return false;
+	memcpy(drv->bigmfmbuf, tc->mfm, (tc->tracklen + 15) / 16 * sizeof(uae_u16));
+	if (tc->timing)
+		memcpy(drv->tracktiming, tc->timing, (tc->tracklen + 7) / 8 * sizeof(uae_u16));
+	drv->tracklen = tc->tracklen;
+	drv->skipoffset = tc->skipoffset;
+	drv->indexoffset = tc->indexoffset;
+	drv->lastrev = 0;
+	return true;
+}
+
+static void trackcache_put(drive *drv, int tr, bool retrytrack)
+{
+	if (!trackcache_usable(drv, tr, retrytrack) || drv->multi_revolution || drv->tracklen <= 0)
+		return;
+	struct trackcache *tc = &drv->trackcache[tr];
+	if (tc->mfm && tc->generation == drv->trackcache_generation && tc->writelen == FLOPPY_WRITE_LEN)
+		return;
+	int words = (drv->tracklen + 15) / 16;
+	int timings = drv->tracktiming[0] ? (drv->tracklen + 7) / 8 : 0;
+	xfree(tc->mfm);
+	xfree(tc->timing);
+	tc->mfm = xmalloc(uae_u16, words);
+	tc->timing = timings ? xmalloc(uae_u16, timings) : NULL;
+	if (!tc->mfm || (timings && !tc->timing)) {
+		xfree(tc->mfm);
+		xfree(tc->timing);
+		tc->mfm = NULL;
+		tc->timing = NULL;
+		return;
+	}
+	memcpy(tc->mfm, drv->bigmfmbuf, words * sizeof(uae_u16));
+	if (timings)
+		memcpy(tc->timing, drv->tracktiming, timings * sizeof(uae_u16));
+	tc->tracklen = drv->tracklen;
+	tc->skipoffset = drv->skipoffset;
+	tc->indexoffset = drv->indexoffset;
+	tc->writelen = FLOPPY_WRITE_LEN;
+	tc->generation = drv->trackcache_generation;
+}
+
 static void drive_image_free (drive *drv)
 {
 	switch (drv->filetype)
@@ -786,6 +885,7 @@ static void drive_image_free (drive *drv)
 #endif
 		break;
 	}
+	trackcache_free(drv);
 	drv->filetype = ADF_NONE;
 	zfile_fclose(drv->diskfile);
 	drv->diskfile = NULL;
@@ -2398,7 +2498,12 @@ static void drive_fill_bigbuf(drive *drv, int tside, int force)
 		drv->track_access_done = false;
 	//write_log (_T("%d:%d %d\n"), drv->cyl, tside, retrytrack);
 
-	if (drv->writediskfile && drv->writetrackdata[tr].bitlen > 0) {
+	if (trackcache_get(drv, tr, retrytrack)) {
+
+		if (disk_debug_logging > 2)
+			write_log(_T("track %d from cache\n"), tr);
+
+	} else if (drv->writediskfile && drv->writetrackdata[tr].bitlen > 0) {
 		int i;
 		trackid *wti = &drv->writetrackdata[tr];
 		drv->tracklen = wti->bitlen;
@@ -2484,6 +2589,7 @@ static void drive_fill_bigbuf(drive *drv, int tside, int force)
 		if (disk_debug_logging > 2)
 			write_log (_T("rawtrack %d image offset=%x\n"), tr, ti->offs);
 	}
+	trackcache_put(drv, tr, retrytrack);
 	drv->buffered_side = tside;
 	drv->buffered_cyl = drv->cyl;
 	if (drv->tracklen == 0) {
@@ -2924,6 +3030,7 @@ static void drive_write_data (drive * drv)
 		drv->buffered_side = 2;
 		return;
 	}
+	drv->trackcache_generation++;
 	if (drv->writediskfile) {
 		drive_write_ext2 (drv->bigmfmbuf, drv->writediskfile, &drv->writetrackdata[tr],
 			floppy_writemode > 0 ? dsklength2 * 8 : drv->tracklen);
@@ -4398,6 +4505,58 @@ static void disk_doupdate_read_nothing(int floppybits)
 	}
 }
 
+/* Fast path for the common case: constant track speed, one MFM bit per step,
+ * no MSBSYNC, and no index, wrap-around or skip position before the next bit.
+ * Does the same per-bit DMA, DSKBYTR and sync work as disk_doupdate_read()
+ * but fetches the MFM stream a word at a time and skips the position
+ * bookkeeping. Returns false if DMA stalled and the caller must stop. */
+static bool disk_doupdate_read_run(drive *drv, int *floppybitsp)
+{
+	const uae_u16 *mfmbuf = drv->bigmfmbuf;
+	const int speed = drv->trackspeed;
+	int floppybits = *floppybitsp;
+	int limit = drv->tracklen;
+
+	if (drv->indexoffset > drv->mfmpos && drv->indexoffset < limit)
+		limit = drv->indexoffset;
+	if (drv->skipoffset > drv->mfmpos && drv->skipoffset < limit)
+		limit = drv->skipoffset;
+	// last bit whose successor position needs no special handling
+	limit--;
+
+	while (drv->mfmpos < limit && floppybits >= speed) {
+		int pos = drv->mfmpos;
+		uae_u32 w = mfmbuf[pos >> 4] << (pos & 15);
+		int cnt = 16 - (pos & 15);
+		if (cnt > limit - pos)
+			cnt = limit - pos;
+		while (cnt-- > 0 && floppybits >= speed) {
+			word <<= 1;
+			word |= (w >> 15) & 1;
+			w <<= 1;
+			if (bitoffset == 15 && doreaddma() < 0) {
+				word >>= 1;
+				*floppybitsp = floppybits;
+				return false;
+			}
+			drv->mfmpos++;
+			if (canloaddskbytr()) {
+				loaddskbytr(floppybits, speed);
+			}
+			if (word != dsksync) {
+				dsksync_on = false;
+			} else {
+				wordsync_detected(false);
+			}
+			bitoffset++;
+			bitoffset &= 15;
+			floppybits -= speed;
+		}
+	}
+	*floppybitsp = floppybits;
+	return true;
+}
+
 static int disk_doupdate_read(drive *drv, int floppybits)
 {
 	/*
@@ -4421,8 +4580,21 @@ static int disk_doupdate_read(drive *drv, int floppybits)
 
 	bool isempty = drive_empty(drv);
 	bool isunformatted = unformatted(drv);
+	bool canrun = !isempty && !isunformatted && !drv->tracktiming[0];
+#ifdef FLOPPYBRIDGE
+	if (drv->bridge)
+		canrun = false;
+#endif
 	while (floppybits >= drv->trackspeed) {
 		bool skipbit = false;
+
+		if (canrun && !(adkcon & 0x200) && nextbit(drv) == 1) {
+			if (!disk_doupdate_read_run(drv, &floppybits))
+				return floppybits;
+			if (floppybits < drv->trackspeed)
+				break;
+		}
+
 		int inc = nextbit(drv);
 
 		if (drv->tracktiming[0])
@@ -52,6 +52,7 @@ happening, all ports should restrict window widths to be multiples of 16 pixels.
 #include "statusline.h"
 #include "inputdevice.h"
 #include "debug.h"
+#include "events.h"
 #ifdef CD32
 #include "cd32_fmv.h"
 #endif
@@ -392,12 +393,47 @@ static void reset_decision_table (void)
 	}
 }
 
+#ifdef AMIBERRY
+/* Warp mode with amiberry.conf warp_present_rate: frames are drawn and
+ * presented at a wall-clock rate instead of every gfx_framerate frames. */
+static frame_time_t warp_present_time;
+static bool warp_present_skip, warp_present_skip_next;
+
+bool warp_present_active(void)
+{
+	return currprefs.turbo_emulation && amiberry_options.warp_present_rate > 0;
+}
+
+/* true if the frame that just ended was not drawn and must not be shown */
+bool warp_present_skipped(void)
+{
+	return warp_present_skip;
+}
+
+static bool warp_present_due(void)
+{
+	frame_time_t now = read_processor_time();
+	if ((frame_time_t)(now - warp_present_time) < syncbase / amiberry_options.warp_present_rate)
+		return false;
+	warp_present_time = now;
+	return true;
+}
+#endif
+
 static void count_frame(int monid)
 {
 	struct amigadisplay *ad = &adisplays[monid];
 	ad->framecnt++;
 	if (ad->framecnt >= currprefs.gfx_framerate || currprefs.monitoremu == MONITOREMU_A2024)
 		ad->framecnt = 0;
+#ifdef AMIBERRY
+	warp_present_skip = warp_present_skip_next;
+	warp_present_skip_next = false;
+	if (warp_present_active() && currprefs.monitoremu != MONITOREMU_A2024) {
+		warp_present_skip_next = !warp_present_due();
+		ad->framecnt = warp_present_skip_next ? 1 : 0;
+	}
+#endif
 	if (ad->inhibit_frame)
 		ad->framecnt = 1;
 }
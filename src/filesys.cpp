@@ -429,6 +429,17 @@ typedef struct key {
 	int createmode;
 	int notifyactive;
 	struct lockrecord *record;
+	/* host side read-ahead and write-behind, see key_read()/key_write() */
+	bool fdstale;
+	uae_u8 *rabuf;
+	uae_u32 rabufsize;
+	uae_u64 rapos;
+	uae_u32 ralen;
+	uae_u32 rawindow;
+	uae_u8 *wbbuf;
+	uae_u64 wbpos;
+	uae_u32 wblen;
+	int wberr;
 } Key;
 
 typedef struct notify {
@@ -521,6 +532,16 @@ typedef struct _unit {
 	bool newreadonly;
 	int newflags;
 
+	/* held while a packet runs on the unit thread, write-behind timer
+	 * flush skips units that hold it or have packets on workers */
+	volatile bool buflock;
+
+	/* optional packet workers, see filesys_iteration() */
+	struct fs_worker *workers;
+	int numworkers;
+	volatile uae_atomic inflight;
+	uae_sem_t workers_done;
+
 } Unit;
 
 int nr_units (void)
@@ -1776,6 +1797,18 @@ static unsigned int fs_write (struct fs_filehandle *fsf, void *b, unsigned int s
 		return my_write (fsf->of, b, size);
 	return 0;
 }
+static int fs_pread (struct fs_filehandle *fsf, void *b, unsigned int size, uae_u64 offset)
+{
+	if (fsf->fstype == FS_DIRECTORY)
+		return my_pread (fsf->of, b, size, offset);
+	return -1;
+}
+static int fs_pwrite (struct fs_filehandle *fsf, void *b, unsigned int size, uae_u64 offset)
+{
+	if (fsf->fstype == FS_DIRECTORY)
+		return my_pwrite (fsf->of, b, size, offset);
+	return -1;
+}
 
 /* return value = old position. -1 = error. */
 static uae_s64 fs_lseek64 (struct fs_filehandle *fsf, uae_s64 offset, int whence)
@@ -1810,19 +1843,248 @@ static uae_u32 fs_fsize (struct fs_filehandle *fsf)
 	return (uae_u32)fs_fsize64 (fsf);
 }
 
+/* Optional host side buffering of directory mounted files (amiberry.conf
+ * filesys_buffering). Small reads are served from a per-key read-ahead
+ * window filled with pread(), the window doubles while access stays
+ * sequential. Small contiguous writes are collected and written with one
+ * pwrite() when the buffer fills, on seek, close, size query, any packet
+ * other than read/write, or by the flush thread every FS_WB_FLUSH_VSYNCS
+ * frames. A failed flush is kept in wberr and returned by the next write,
+ * seek or close of the handle.
+ * pread()/pwrite() don't move the host file position, fdstale tells
+ * key_seek() that it no longer matches file_pos. */
+#ifdef AMIBERRY
+#define FS_BUFFERING (amiberry_options.filesys_buffering)
+#else
+#define FS_BUFFERING 0
+#endif
+#define FS_RA_MIN 4096
+#define FS_RA_MAX (256 * 1024)
+#define FS_WB_SIZE (64 * 1024)
+#define FS_WB_FLUSH_VSYNCS 25
+
+static volatile uae_atomic fs_wb_pending;
+static uae_thread_id fs_wb_tid;
+static uae_sem_t fs_wb_sem;
+static volatile bool fs_wb_quit;
+static volatile uae_atomic fs_wb_signaled;
+static int fs_wb_vsyncs;
+
+static bool key_buffered(Key *k)
+{
+	return FS_BUFFERING && k->fd && k->fd->fstype == FS_DIRECTORY && !k->aino->vfso;
+}
+
+static void key_flush_write(Key *k)
+{
+	if (!k->wblen)
+		return;
+	int v = fs_pwrite (k->fd, k->wbbuf, k->wblen, k->wbpos);
+	if (v != (int)k->wblen) {
+		int err = v < 0 ? dos_errno () : ERROR_DISK_IS_FULL;
+		write_log (_T("FS: write-behind flush of '%s' failed (%d/%u)\n"), k->aino->nname, v, k->wblen);
+		if (!k->wberr)
+			k->wberr = err;
+	}
+	k->wblen = 0;
+	atomic_dec(&fs_wb_pending);
+}
+
+/* error of an earlier write-behind flush, cleared once reported */
+static int key_take_wberr(Key *k)
+{
+	int err = k->wberr;
+	k->wberr = 0;
+	return err;
+}
+
+static void key_free_buffers(Key *k)
+{
+	key_flush_write(k);
+	xfree (k->rabuf);
+	xfree (k->wbbuf);
+	k->rabuf = k->wbbuf = NULL;
+	k->rabufsize = k->ralen = 0;
+}
+
+/* other handles of the same file: flush their pending writes, drop their
+ * read-ahead too if this handle is about to modify the file */
+static void key_sync_others(Unit *unit, Key *k, bool modify)
+{
+	for (Key *k1 = unit->keys; k1; k1 = k1->next) {
+		if (k1 == k || k1->aino != k->aino)
+			continue;
+		key_flush_write(k1);
+		if (modify)
+			k1->ralen = 0;
+	}
+}
+
+static void unit_flush_writes(Unit *unit)
+{
+	for (Key *k = unit->keys; k; k = k->next)
+		key_flush_write(k);
+}
+
+static void unit_buffers_lock(Unit *unit)
+{
+	while (__atomic_test_and_set(&unit->buflock, __ATOMIC_ACQUIRE))
+		sleep_millis(1);
+}
+
+static void unit_buffers_unlock(Unit *unit)
+{
+	__atomic_clear(&unit->buflock, __ATOMIC_RELEASE);
+}
+
+static int key_read(TrapContext *ctx, Key *k, uaecptr addr, uae_u32 size)
+{
+	uae_u64 pos = k->file_pos;
+	uae_u32 done = 0;
+
+	key_flush_write(k);
+	k->fdstale = true;
+	while (size > 0) {
+		if (pos >= k->rapos && pos < k->rapos + k->ralen) {
+			uae_u32 off = (uae_u32)(pos - k->rapos);
+			uae_u32 n = k->ralen - off;
+			if (n > size)
+				n = size;
+			trap_put_bytes(ctx, k->rabuf + off, addr + done, n);
+			done += n;
+			pos += n;
+			size -= n;
+			continue;
+		}
+		// sequential access grows the window, anything else starts over
+		if (k->ralen && pos == k->rapos + k->ralen)
+			k->rawindow = k->rawindow * 2 > FS_RA_MAX ? FS_RA_MAX : k->rawindow * 2;
+		else
+			k->rawindow = FS_RA_MIN;
+		uae_u32 window = k->rawindow;
+		while (window < size && window < FS_RA_MAX)
+			window *= 2;
+		if (window > k->rabufsize) {
+			xfree (k->rabuf);
+			k->rabuf = xmalloc (uae_u8, window);
+			k->rabufsize = window;
+		}
+		int v = fs_pread (k->fd, k->rabuf, window, pos);
+		k->rapos = pos;
+		k->ralen = v > 0 ? v : 0;
+		if (v <= 0) {
+			if (v < 0 && !done)
+				return -1;
+			break;
+		}
+	}
+	return done;
+}
+
+static int key_write(TrapContext *ctx, Key *k, uaecptr addr, uae_u32 size)
+{
+	k->ralen = 0;
+	k->fdstale = true;
+	if (k->wblen && (k->file_pos != k->wbpos + k->wblen || k->wblen + size > FS_WB_SIZE))
+		key_flush_write(k);
+	if (!k->wbbuf)
+		k->wbbuf = xmalloc (uae_u8, FS_WB_SIZE);
+	if (!k->wblen) {
+		k->wbpos = k->file_pos;
+		atomic_inc(&fs_wb_pending);
+	}
+	trap_get_bytes(ctx, k->wbbuf + k->wblen, addr, size);
+	k->wblen += size;
+	return size;
+}
+
+/* Write-behind flush thread, keeps the pwrite() calls off the emulation
+ * thread. Units busy with a packet are skipped. inflight only changes
+ * from zero under buflock, workers own their keys until they decrement
+ * it. */
+static int filesys_flush_thread(void *v)
+{
+	for (;;) {
+		uae_sem_wait(&fs_wb_sem);
+		if (fs_wb_quit)
+			break;
+		for (Unit *u = units; u; u = u->next) {
+			if (__atomic_test_and_set(&u->buflock, __ATOMIC_ACQUIRE))
+				continue;
+			if (!u->inflight)
+				unit_flush_writes(u);
+			unit_buffers_unlock(u);
+		}
+		atomic_set(&fs_wb_signaled, 0);
+	}
+	return 0;
+}
+
+static void filesys_flush_thread_stop(void)
+{
+	if (!fs_wb_tid)
+		return;
+	fs_wb_quit = true;
+	uae_sem_post(&fs_wb_sem);
+	uae_wait_thread(&fs_wb_tid);
+	uae_sem_destroy(&fs_wb_sem);
+	fs_wb_tid = 0;
+	fs_wb_quit = false;
+	atomic_set(&fs_wb_signaled, 0);
+}
+
+/* called from filesys_vsync() */
+static void filesys_flush_writes_timer(void)
+{
+	if (!fs_wb_pending) {
+		fs_wb_vsyncs = 0;
+		return;
+	}
+	if (++fs_wb_vsyncs < FS_WB_FLUSH_VSYNCS)
+		return;
+	fs_wb_vsyncs = 0;
+	if (!fs_wb_tid) {
+		uae_sem_init(&fs_wb_sem, 0, 0);
+		if (!uae_start_thread(_T("filesys flush"), filesys_flush_thread, NULL, &fs_wb_tid)) {
+			uae_sem_destroy(&fs_wb_sem);
+			fs_wb_tid = 0;
+			return;
+		}
+	}
+	if (atomic_inc(&fs_wb_signaled) == 1)
+		uae_sem_post(&fs_wb_sem);
+}
+
 static uae_s64 key_filesize(Key *k)
 {
 	if (k->aino->vfso)
 		return k->aino->vfso->size;
+	key_flush_write(k);
 	return fs_fsize64 (k->fd);
 }
 static uae_s64 key_seek(Key *k, uae_s64 offset, int whence)
 {
 	if (k->aino->vfso)
 		return k->file_pos;
+	key_flush_write(k);
+	if (k->fdstale) {
+		k->fdstale = false;
+		if (whence == SEEK_CUR) {
+			offset += k->file_pos;
+			whence = SEEK_SET;
+		}
+	}
 	return fs_lseek64 (k->fd, offset, whence);
 }
 
+/* before truncating/extending: host position and all handles in sync */
+static void key_sync_truncate(Unit *unit, Key *k)
+{
+	key_seek(k, k->file_pos, SEEK_SET);
+	k->ralen = 0;
+	key_sync_others(unit, k, true);
+}
+
 static void set_highcyl(uaecptr volume, uae_u32 blocks)
 {
 	put_long(volume + 184 - 32, blocks);
@@ -3601,6 +3863,7 @@ static void free_key (Unit *unit, Key *k)
 		lr = next;
 	}
 
+	key_free_buffers(k);
 	if (k->fd != NULL)
 		fs_closefile (k->fd);
 
@@ -5421,8 +5684,11 @@ static void	action_end(TrapContext *ctx, Unit *unit, dpacket *packet)
 	Key *k;
 	TRACE((_T("ACTION_END(0x%x)\n"), GET_PCK_ARG1 (packet)));
 
+	int err = 0;
 	k = lookup_key (unit, GET_PCK_ARG1 (packet));
 	if (k != 0) {
+		key_flush_write(k);
+		err = key_take_wberr(k);
 		if (k->notifyactive) {
 			notify_check(ctx, unit, k->aino);
 			updatedirtime (k->aino, 1);
@@ -5434,6 +5700,11 @@ static void	action_end(TrapContext *ctx, Unit *unit, dpacket *packet)
 		recycle_aino (unit, k->aino);
 		free_key (unit, k);
 	}
+	if (err) {
+		PUT_PCK_RES1 (packet, DOS_FALSE);
+		PUT_PCK_RES2 (packet, err);
+		return;
+	}
 	PUT_PCK_RES1 (packet, DOS_TRUE);
 	PUT_PCK_RES2 (packet, 0);
 }
@@ -5452,6 +5723,8 @@ static void	action_read(TrapContext *ctx, Unit *unit, dpacket *packet)
 	}
 	TRACE((_T("ACTION_READ(%s,0x%x,%d)\n"), k->aino->nname, addr, size));
 	gui_flicker_led (UNIT_LED(unit), unit->unit, 1);
+	if (FS_BUFFERING)
+		key_sync_others(unit, k, false);
 
 	if (size == 0) {
 		PUT_PCK_RES1 (packet, 0);
@@ -5512,14 +5785,22 @@ static void	action_read(TrapContext *ctx, Unit *unit, dpacket *packet)
 	}
 
 	if (size) {
+		uae_u8 *realpt;
 
-		if (key_seek(k, k->file_pos, SEEK_SET) < 0) {
+		if (size < FS_RA_MAX / 4 && key_buffered(k)) {
+
+			actual = key_read(ctx, k, addr, size);
+
+		} else if (key_seek(k, k->file_pos, SEEK_SET) < 0) {
 			PUT_PCK_RES1(packet, 0);
 			PUT_PCK_RES2(packet, dos_errno());
 			return;
-		}
+		} else if ((realpt = trap_get_host_address(ctx, addr, size))) {
+
+			/* normal fast read, indirect traps too if buffer is plain RAM */
+			actual = fs_read (k->fd, realpt, size);
 
-		if (trap_is_indirect() || !real_address_allowed()) {
+		} else {
 
 			uae_u8 buf[RTAREA_TRAP_DATA_EXTRA_SIZE];
 			actual = 0;
@@ -5540,12 +5821,6 @@ static void	action_read(TrapContext *ctx, Unit *unit, dpacket *packet)
 					break;
 			}
 
-		} else {
-
-			/* normal fast read */
-			uae_u8 *realpt = get_real_address (addr);
-			actual = fs_read (k->fd, realpt, size);
-
 		}
 
 		if (actual == 0) {
@@ -5585,6 +5860,16 @@ static void action_write(TrapContext *ctx, Unit *unit, dpacket *packet)
 		PUT_PCK_RES2 (packet, ERROR_DISK_WRITE_PROTECTED);
 		return;
 	}
+	if (FS_BUFFERING) {
+		key_sync_others(unit, k, true);
+		k->ralen = 0;
+		int err = key_take_wberr(k);
+		if (err) {
+			PUT_PCK_RES1 (packet, -1);
+			PUT_PCK_RES2 (packet, err);
+			return;
+		}
+	}
 
 	if (size == 0) {
 
@@ -5592,6 +5877,10 @@ static void action_write(TrapContext *ctx, Unit *unit, dpacket *packet)
 		PUT_PCK_RES1 (packet, 0);
 		PUT_PCK_RES2 (packet, 0);
 
+	} else if (size <= FS_WB_SIZE / 4 && key_buffered(k)) {
+
+		actual = key_write(ctx, k, addr, size);
+
 	} else if (trap_valid_address(ctx, addr, size)) {
 
 		if (key_seek(k, k->file_pos, SEEK_SET) < 0) {
@@ -5600,7 +5889,12 @@ static void action_write(TrapContext *ctx, Unit *unit, dpacket *packet)
 			return;
 		}
 
-		if (trap_is_indirect() || !real_address_allowed()) {
+		uae_u8 *realpt = trap_get_host_address(ctx, addr, size);
+		if (realpt) {
+
+			actual = fs_write (k->fd, realpt, size);
+
+		} else {
 
 			uae_u8 buf[RTAREA_TRAP_DATA_EXTRA_SIZE];
 			actual = 0;
@@ -5622,10 +5916,6 @@ static void action_write(TrapContext *ctx, Unit *unit, dpacket *packet)
 					break;
 			}
 
-		} else {
-
-			uae_u8 *realpt = get_real_address (addr);
-			actual = fs_write (k->fd, realpt, size);
 		}
 
 	} else {
@@ -5686,6 +5976,12 @@ static void	action_seek(TrapContext *ctx, Unit *unit, dpacket *packet)
 	gui_flicker_led (UNIT_LED(unit), unit->unit, 1);
 
 	filesize = key_filesize(k);
+	int err = key_take_wberr(k);
+	if (err) {
+		PUT_PCK_RES1 (packet, -1);
+		PUT_PCK_RES2 (packet, err);
+		return;
+	}
 	if (whence == SEEK_CUR)
 		temppos = cur + pos;
 	if (whence == SEEK_SET)
@@ -6045,6 +6341,7 @@ static void	action_set_file_size(TrapContext *ctx, Unit *unit, dpacket *packet)
 
 	gui_flicker_led (UNIT_LED(unit), unit->unit, 1);
 	k->notifyactive = 1;
+	key_sync_truncate(unit, k);
 	/* If any open files have file pointers beyond this size, truncate only
 	 * so far that these pointers do not become invalid.  */
 	for (k1 = unit->keys; k1; k1 = k1->next) {
@@ -6530,6 +6827,12 @@ static void action_change_file_position64(TrapContext *ctx, Unit *unit, dpacket
 	{
 		uae_s64 temppos;
 		uae_s64 filesize = key_filesize(k);
+		int err = key_take_wberr(k);
+		if (err) {
+			PUT_PCK64_RES1 (packet, DOS_FALSE);
+			PUT_PCK64_RES2 (packet, err);
+			return;
+		}
 
 		if (whence == SEEK_CUR)
 			temppos = cur + pos;
@@ -6598,6 +6901,7 @@ static void action_change_file_size64(TrapContext *ctx, Unit *unit, dpacket *pac
 
 	gui_flicker_led (UNIT_LED(unit), unit->unit, 1);
 	k->notifyactive = 1;
+	key_sync_truncate(unit, k);
 	/* If any open files have file pointers beyond this size, truncate only
 	* so far that these pointers do not become invalid.  */
 	for (k1 = unit->keys; k1; k1 = k1->next) {
@@ -6691,6 +6995,7 @@ static void action_set_file_size64(TrapContext *ctx, Unit *unit, dpacket *packet
 
 	gui_flicker_led (UNIT_LED(unit), unit->unit, 1);
 	k->notifyactive = 1;
+	key_sync_truncate(unit, k);
 	/* If any open files have file pointers beyond this size, truncate only
 	* so far that these pointers do not become invalid.  */
 	for (k1 = unit->keys; k1; k1 = k1->next) {
@@ -6744,6 +7049,12 @@ static void action_seek64(TrapContext *ctx, Unit *unit, dpacket *packet)
 	{
 		uae_s64 temppos;
 		uae_s64 filesize = key_filesize(k);
+		int err = key_take_wberr(k);
+		if (err) {
+			PUT_PCK_RES1 (packet, DOS_FALSE);
+			PUT_PCK_RES2 (packet, err);
+			return;
+		}
 
 		if (whence == SEEK_CUR)
 			temppos = cur + pos;
@@ -7056,7 +7367,7 @@ end:
 	return 0;
 }
 
-static int handle_packet(TrapContext *ctx, Unit *unit, dpacket *pck, uae_u32 msg, int isvolume)
+static int handle_packet2(TrapContext *ctx, Unit *unit, dpacket *pck, uae_u32 msg, int isvolume)
 {
 	bool noidle = false;
 	int ret = 1;
@@ -7157,8 +7468,211 @@ static int handle_packet(TrapContext *ctx, Unit *unit, dpacket *pck, uae_u32 msg
 	return ret;
 }
 
+static int handle_packet(TrapContext *ctx, Unit *unit, dpacket *pck, uae_u32 msg, int isvolume)
+{
+	if (!FS_BUFFERING)
+		return handle_packet2(ctx, unit, pck, msg, isvolume);
+	unit_buffers_lock(unit);
+	/* everything except read/write may look at file size or contents */
+	uae_s32 type = GET_PCK_TYPE (pck);
+	if (fs_wb_pending && type != ACTION_READ && type != ACTION_WRITE)
+		unit_flush_writes(unit);
+	int ret = handle_packet2(ctx, unit, pck, msg, isvolume);
+	unit_buffers_unlock(unit);
+	return ret;
+}
+
 #ifdef UAE_FILESYS_THREADS
 
+/* Optional per-unit packet workers (amiberry.conf filesys_workers).
+ * The unit thread stays the dispatcher. Reads, writes and seeks of a file
+ * that has no other packet in flight go to an idle worker, so one slow
+ * host transfer doesn't hold up the rest of the volume. Every other
+ * packet type touches shared unit state (locks, aino cache, notify,
+ * ExAll) and first waits until all workers are idle, then runs on the
+ * unit thread as before. Each worker replies as soon as its packet is
+ * done. Lock list hand-over and replies are serialised with buflock.
+ * Only host directory mounts qualify. With indirect traps the handler
+ * task waits for each packet to complete before sending the next, so
+ * there is nothing to overlap and the workers are not used. */
+#ifdef AMIBERRY
+#define FS_WORKERS (amiberry_options.filesys_workers)
+#else
+#define FS_WORKERS 0
+#endif
+#define FS_WORKERS_MAX 8
+
+struct fs_worker {
+	UnitInfo *ui;
+	uae_thread_id tid;
+	uae_sem_t start;
+	volatile bool busy;
+	bool quit;
+	TrapContext *ctx;
+	uaecptr msg;
+	int isvolume;
+	a_inode *aino;
+	dpacket packet;
+};
+
+static void filesys_packet_done(TrapContext *ctx, UnitInfo *ui, dpacket *packet, uaecptr msg, int ret)
+{
+	if (!ret) {
+		PUT_PCK_RES1 (packet, DOS_FALSE);
+		PUT_PCK_RES2 (packet, ERROR_ACTION_NOT_KNOWN);
+	}
+	writedpacket(ctx, packet);
+
+	trapmd md2[] = {
+		{ TRAPCMD_PUT_LONG, { msg + 4, 0xffffffff } },
+		{ TRAPCMD_GET_LONG, { ui->self->locklist } },
+		{ TRAPCMD_PUT_LONG, { ui->self->locklist, 0 } }
+	};
+	struct trapmd *mdp;
+	int mdcnt;
+	if (ret >= 0) {
+		mdp = &md2[0];
+		mdcnt = 3;
+		/* Mark the packet as processed for the list scan in the assembly code. */
+		//trap_put_long(ctx, msg + 4, 0xffffffff);
+	} else {
+		mdp = &md2[1];
+		mdcnt = 2;
+	}
+	/* Acquire the message lock, so that we know we can safely send the message. */
+	ui->self->cmds_sent++;
+
+	/* Send back the locks. */
+	trap_multi(ctx, mdp, mdcnt);
+	if (md2[1].params[0] != 0)
+		write_comm_pipe_int(ui->back_pipe, (int)md2[1].params[0], 0);
+
+	/* The message is sent by our interrupt handler, so make sure an interrupt happens. */
+	do_uae_int_requested();
+#if 0
+	uae_u32 v = trap_get_long(ctx, ui->self->locklist);
+	if (v != 0)
+		write_comm_pipe_int (ui->back_pipe, (int)v, 0);
+	trap_put_long(ctx, ui->self->locklist, 0);
+#endif
+
+	trap_background_set_complete(ctx);
+}
+
+/* file the packet works on if it may run on a worker, NULL if not */
+static a_inode *filesys_packet_parallel(Unit *unit, dpacket *pck)
+{
+	switch (GET_PCK_TYPE (pck))
+	{
+	case ACTION_READ:
+	case ACTION_WRITE:
+	case ACTION_SEEK:
+		break;
+	default:
+		return NULL;
+	}
+	for (Key *k = unit->keys; k; k = k->next) {
+		/* archive and CD image reads share zfiles and are not thread safe */
+		if (k->uniq == GET_PCK_ARG1 (pck))
+			return k->fd && k->fd->fstype == FS_DIRECTORY && !k->aino->vfso ? k->aino : NULL;
+	}
+	return NULL;
+}
+
+static int filesys_worker_thread(void *v)
+{
+	struct fs_worker *w = (struct fs_worker*)v;
+	UnitInfo *ui = w->ui;
+	Unit *unit = ui->self;
+
+	for (;;) {
+		uae_sem_wait(&w->start);
+		if (w->quit)
+			break;
+		int ret = handle_packet2(w->ctx, unit, &w->packet, w->msg, w->isvolume);
+		unit_buffers_lock(unit);
+		filesys_packet_done(w->ctx, ui, &w->packet, w->msg, ret);
+		unit_buffers_unlock(unit);
+		w->busy = false;
+		atomic_dec(&unit->inflight);
+		uae_sem_post(&unit->workers_done);
+	}
+	return 0;
+}
+
+static bool filesys_workers_start(UnitInfo *ui)
+{
+	Unit *unit = ui->self;
+	int num = FS_WORKERS;
+
+	if (unit->workers)
+		return true;
+	if (num <= 0)
+		return false;
+	if (num > FS_WORKERS_MAX)
+		num = FS_WORKERS_MAX;
+	unit->workers = xcalloc(struct fs_worker, num);
+	uae_sem_init(&unit->workers_done, 0, 0);
+	for (int i = 0; i < num; i++) {
+		struct fs_worker *w = &unit->workers[i];
+		w->ui = ui;
+		uae_sem_init(&w->start, 0, 0);
+		if (!uae_start_thread(_T("filesys worker"), filesys_worker_thread, w, &w->tid)) {
+			uae_sem_destroy(&w->start);
+			break;
+		}
+		unit->numworkers++;
+	}
+	write_log(_T("FS: unit %d, %d packet workers\n"), unit->unit, unit->numworkers);
+	return unit->numworkers > 0;
+}
+
+static void filesys_workers_drain(Unit *unit)
+{
+	while (unit->inflight)
+		uae_sem_wait(&unit->workers_done);
+}
+
+static void filesys_workers_stop(Unit *unit)
+{
+	if (!unit || !unit->workers)
+		return;
+	filesys_workers_drain(unit);
+	for (int i = 0; i < unit->numworkers; i++) {
+		struct fs_worker *w = &unit->workers[i];
+		w->quit = true;
+		uae_sem_post(&w->start);
+		uae_wait_thread(&w->tid);
+		uae_sem_destroy(&w->start);
+	}
+	uae_sem_destroy(&unit->workers_done);
+	xfree(unit->workers);
+	unit->workers = NULL;
+	unit->numworkers = 0;
+}
+
+/* idle worker for a packet on 'aino', waits while none is free or
+ * another packet of the same file is still in flight */
+static struct fs_worker *filesys_worker_get(Unit *unit, a_inode *aino)
+{
+	for (;;) {
+		struct fs_worker *idle = NULL;
+		bool conflict = false;
+		for (int i = 0; i < unit->numworkers; i++) {
+			struct fs_worker *w = &unit->workers[i];
+			if (!w->busy) {
+				if (!idle)
+					idle = w;
+			} else if (w->aino == aino) {
+				conflict = true;
+			}
+		}
+		if (idle && !conflict)
+			return idle;
+		uae_sem_wait(&unit->workers_done);
+	}
+}
+
 static int filesys_iteration(UnitInfo *ui)
 {
 	uaecptr pck;
@@ -7176,6 +7690,7 @@ static int filesys_iteration(UnitInfo *ui)
 		if (pck != 0)
 		   return 1;
 		/* Death message received. */
+		filesys_workers_stop(ui->self);
 		uae_sem_post (&ui->reset_sync_sem);
 		/* Die.  */
 		return 0;
@@ -7184,6 +7699,11 @@ static int filesys_iteration(UnitInfo *ui)
 	dpacket packet;
 	readdpacket(ctx, &packet, pck);
 
+	Unit *unit = ui->self;
+	bool workers = unit->workers || (FS_WORKERS > 0 && !trap_is_indirect());
+	if (workers)
+		unit_buffers_lock(unit);
+
 	int isvolume = 0;
 #if TRAPMD
 	trapmd md[] = {
@@ -7206,51 +7726,35 @@ static int filesys_iteration(UnitInfo *ui)
 	}
 #endif
 
-	int ret = handle_packet(ctx, ui->self, &packet, msg, isvolume);
-	if (!ret) {
-		PUT_PCK_RES1 (&packet, DOS_FALSE);
-		PUT_PCK_RES2 (&packet, ERROR_ACTION_NOT_KNOWN);
-	}
-	writedpacket(ctx, &packet);
-
-	trapmd md2[] = {
-		{ TRAPCMD_PUT_LONG, { msg + 4, 0xffffffff } },
-		{ TRAPCMD_GET_LONG, { ui->self->locklist } },
-		{ TRAPCMD_PUT_LONG, { ui->self->locklist, 0 } }
-	};
-	struct trapmd *mdp;
-	int mdcnt;
-	if (ret >= 0) {
-		mdp = &md2[0];
-		mdcnt = 3;
-		/* Mark the packet as processed for the list scan in the assembly code. */
-		//trap_put_long(ctx, msg + 4, 0xffffffff);
-	} else {
-		mdp = &md2[1];
-		mdcnt = 2;
+	if (workers) {
+		unit_buffers_unlock(unit);
+		a_inode *aino = filesys_packet_parallel(unit, &packet);
+		if (aino && filesys_workers_start(ui)) {
+			struct fs_worker *w = filesys_worker_get(unit, aino);
+			w->ctx = ctx;
+			w->msg = msg;
+			w->isvolume = isvolume;
+			w->aino = aino;
+			w->packet = packet;
+			if (packet.packet_data == packet.packet_array)
+				w->packet.packet_data = w->packet.packet_array;
+			/* under buflock, so a write-behind flush either finished
+			 * before or sees the unit busy until the worker is done */
+			unit_buffers_lock(unit);
+			atomic_inc(&unit->inflight);
+			unit_buffers_unlock(unit);
+			w->busy = true;
+			uae_sem_post(&w->start);
+			return 1;
+		}
+		filesys_workers_drain(unit);
 	}
-	/* Acquire the message lock, so that we know we can safely send the message. */
-	ui->self->cmds_sent++;
-
-	/* Send back the locks. */
-	trap_multi(ctx, mdp, mdcnt);
-	if (md2[1].params[0] != 0)
-		write_comm_pipe_int(ui->back_pipe, (int)md2[1].params[0], 0);
 
-	/* The message is sent by our interrupt handler, so make sure an interrupt happens. */
-	do_uae_int_requested();
-#if 0
-	uae_u32 v = trap_get_long(ctx, ui->self->locklist);
-	if (v != 0)
-		write_comm_pipe_int (ui->back_pipe, (int)v, 0);
-	trap_put_long(ctx, ui->self->locklist, 0);
-#endif
-
-	trap_background_set_complete(ctx);
+	int ret = handle_packet(ctx, ui->self, &packet, msg, isvolume);
+	filesys_packet_done(ctx, ui, &packet, msg, ret);
 	return 1;
 }
 
-
 static int filesys_thread (void *unit_v)
 {
 	UnitInfo *ui = (UnitInfo *)unit_v;
@@ -7367,11 +7871,14 @@ void filesys_start_threads (void)
 void filesys_free_handles (void)
 {
 	Unit *u, *u1;
+
+	filesys_flush_thread_stop();
 	for (u = units; u; u = u1) {
 		Key *k1, *knext;
 		u1 = u->next;
 		for (k1 = u->keys; k1; k1 = knext) {
 			knext = k1->next;
+			key_free_buffers(k1);
 			if (k1->fd)
 				fs_closefile (k1->fd);
 			xfree (k1);
@@ -7409,6 +7916,8 @@ static void filesys_reset2 (void)
 	Unit *u, *u1;
 
 
+	for (u = units; u; u = u->next)
+		filesys_workers_stop(u);
 	filesys_free_handles ();
 	for (u = units; u; u = u1) {
 		u1 = u->next;
@@ -9294,6 +9803,9 @@ void filesys_vsync (void)
 	if (uae_boot_rom_type <= 0)
 		return;
 
+	if (FS_BUFFERING)
+		filesys_flush_writes_timer();
+
 	if (shellexecute2_queued > 0) {
 		if (!uae_sem_trywait(&shellexec_sem)) {
 			filesys_shellexecute2_run_queue();
@@ -10032,6 +10544,7 @@ static uae_u8 *save_key (uae_u8 *dst, Key *k)
 	save_u32 ((uae_u32)k->file_pos);
 	save_u32 (k->createmode);
 	save_u32 (k->dosmode);
+	key_flush_write(k);
 	size = fs_fsize (k->fd);
 	save_u32 ((uae_u32)size);
 	save_u64 (k->aino->uniq);
@@ -12,6 +12,8 @@
 
 #define FPU_TEST 0
 #define FPU_LOG 0
+// cross-check lazily evaluated FPSR condition codes against eager evaluation
+#define FPSR_LAZY_CHECK 0
 
 #include <math.h>
 #include <float.h>
@@ -56,6 +58,11 @@ bool use_long_double = false;
 static bool support_exceptions;
 static bool support_denormals;
 static uae_u32 fpcr_mask, fpsr_mask;
+// FPSR condition code byte not yet evaluated from regs.fp_result
+static bool fpsr_cc_pending;
+#if FPSR_LAZY_CHECK
+static uae_u32 fpsr_cc_check;
+#endif
 
 FPP_PRINT fpp_print;
 
@@ -615,6 +622,51 @@ static void fpsr_set_result(fpdata *result)
 		regs.fpsr |= FPSR_CC_I;
 	}
 }
+
+// Without exception support nothing looks at the condition codes until
+// FBcc/FScc/FTRAPcc/FDBcc or an FPSR read, most results are overwritten
+// before that. Only remember the result and classify it on demand.
+static bool fpsr_lazy(void)
+{
+#ifdef CPU_TESTER
+	return false;
+#else
+	return !support_exceptions && !jit_fpu();
+#endif
+}
+
+static void fpsr_flush_cc(void)
+{
+	if (!fpsr_cc_pending)
+		return;
+	fpsr_cc_pending = false;
+	fpsr_set_result_always(&regs.fp_result);
+	fpsr_set_result(&regs.fp_result);
+#if FPSR_LAZY_CHECK
+	if ((regs.fpsr & 0x0f000000) != fpsr_cc_check)
+		write_log(_T("FPSR lazy CC mismatch %08x <> %08x PC=%08x\n"), regs.fpsr & 0x0f000000, fpsr_cc_check, M68K_GETPC);
+#endif
+}
+
+// Both fpsr_set_result_always() and fpsr_set_result()
+static void fpsr_set_result_cc(fpdata *result)
+{
+	if (!fpsr_lazy()) {
+		fpsr_cc_pending = false;
+		fpsr_set_result_always(result);
+		fpsr_set_result(result);
+		return;
+	}
+#if FPSR_LAZY_CHECK
+	uae_u32 fpsr = regs.fpsr;
+	fpsr_set_result_always(result);
+	fpsr_set_result(result);
+	fpsr_cc_check = regs.fpsr & 0x0f000000;
+	regs.fpsr = fpsr;
+#endif
+	regs.fp_result = *result;
+	fpsr_cc_pending = true;
+}
 static void fpsr_clear_status(void)
 {
 	// clear exception status byte only
@@ -691,6 +743,7 @@ static void fpsr_get_quotient(uae_u64 *quot, uae_u8 *sign)
 
 uae_u32 fpp_get_fpsr (void)
 {
+	fpsr_flush_cc();
 #ifdef JIT
 	if (currprefs.cachesize && currprefs.compfpu) {
 		regs.fpsr &= 0x00fffff8; // clear cc
@@ -736,6 +789,7 @@ static void fpset (fpdata *fpd, uae_s32 val)
 
 void fpp_set_fpsr (uae_u32 val)
 {
+	fpsr_cc_pending = false;
 	regs.fpsr = val & fpsr_mask;
 
 #ifdef JIT
@@ -902,6 +956,9 @@ bool fpu_get_constant(fpdata *fpd, int cr)
 				fpp_to_exten_fmovem(fpd, f[0], f[1], f[2]);
 			}
 
+			// sr adds condition codes on top of the result's, a lazy
+			// flush would clear them again, so evaluate them now
+			fpsr_cc_pending = false;
 			fpsr_set_result_always(fpd);
 			fpsr_set_result(fpd);
 			regs.fpsr |= sr;
@@ -926,8 +983,7 @@ bool fpu_get_constant(fpdata *fpd, int cr)
 	if (prec >= 2)
 		fpp_round64(fpd);
 	
-	fpsr_set_result_always(fpd);
-	fpsr_set_result(fpd);
+	fpsr_set_result_cc(fpd);
 
 	return true;
 }
@@ -1448,6 +1504,7 @@ static void fpu_null (void)
 	regs.fpcr = 0;
 	regs.fpsr = 0;
 	regs.fpiar = 0;
+	fpsr_cc_pending = false;
 	for (int i = 0; i < 8; i++)
 		fpnan (&regs.fp[i]);
 }
@@ -2100,6 +2157,7 @@ int fpp_cond(int condition)
 	} else
 #endif
 	{
+		fpsr_flush_cc();
 		if ((condition & 0x10) && (regs.fpsr & FPSR_CC_NAN)) {
 			if (fpsr_set_bsun())
 				return -2;
@@ -3123,8 +3181,7 @@ static bool fp_arithmetic(fpdata *src, fpdata *dst, int extra)
 		{
 			fpp_cmp(dst, src);
 			fpsr_make_status();
-			fpsr_set_result_always(dst);
-			fpsr_set_result(dst);
+			fpsr_set_result_cc(dst);
 			return false;
 		}
 		case 0x3a: /* FTST */
@@ -3134,8 +3191,7 @@ static bool fp_arithmetic(fpdata *src, fpdata *dst, int extra)
 		{
 			fpp_tst(dst, src);
 			fpsr_make_status();
-			fpsr_set_result_always(dst);
-			fpsr_set_result(dst);
+			fpsr_set_result_cc(dst);
 			return false;
 		}
 		default:
@@ -3143,8 +3199,7 @@ static bool fp_arithmetic(fpdata *src, fpdata *dst, int extra)
 			return false;
 	}
 
-	fpsr_set_result_always(dst);
-	fpsr_set_result(dst);
+	fpsr_set_result_cc(dst);
 
 	if (fpsr_make_status()) {
 		return false;
@@ -3718,6 +3773,7 @@ void fpu_reset (void)
 	regs.fpu_exp_state = 0;
 	regs.fp_unimp_pend = 0;
 	regs.fp_ea_set = false;
+	fpsr_cc_pending = false;
 	get_features();
 	fpp_set_fpcr (0);
 	fpp_set_fpsr (0);
@@ -3754,6 +3810,7 @@ uae_u8 *restore_fpu (uae_u8 *src)
 	}
 	regs.fpcr = restore_u32 ();
 	regs.fpsr = restore_u32 ();
+	fpsr_cc_pending = false;
 	regs.fpiar = restore_u32 ();
 	regs.fp_ea_set = (flags & 0x00000001) != 0;
 	fpsr_make_status();
@@ -3826,6 +3883,7 @@ uae_u8 *save_fpu(size_t *len, uae_u8 *dstptr)
 		save_u32 (w2);
 		save_u32 (w3);
 	}
+	fpsr_flush_cc();
 	save_u32 (regs.fpcr);
 	save_u32 (regs.fpsr);
 	save_u32 (regs.fpiar);
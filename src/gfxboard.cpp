@@ -25,6 +25,10 @@ static bool memlogr = true;
 static bool memlogw = true;
 #endif
 
+// VRAM dirty tracking granularity and forced full refresh interval (frames)
+#define VRAM_DIRTY_PAGE_SHIFT 12
+#define VRAM_DIRTY_REFRESH 50
+
 #define BYTESWAP_WORD -1
 #define BYTESWAP_LONG 1
 
@@ -453,6 +457,9 @@ struct rtggfxboard
 	bool monswitch_reset;
 	int monswitch_delay;
 	int fullrefresh;
+	uae_u32 *vram_dirty;
+	int vram_dirty_pages;
+	int vram_dirty_refresh;
 	int resolutionchange;
 	uae_u8 *gfxboard_surface, *fakesurface_surface;
 	bool gfxboard_intreq;
@@ -985,6 +992,58 @@ static void reinit_vram(struct rtggfxboard *gb, uaecptr vram, bool direct)
 	}
 }
 
+static void gfxboard_vram_dirty_alloc(struct rtggfxboard *gb, int size)
+{
+	xfree(gb->vram_dirty);
+	gb->vram_dirty_pages = (size + (1 << VRAM_DIRTY_PAGE_SHIFT) - 1) >> VRAM_DIRTY_PAGE_SHIFT;
+	gb->vram_dirty = xcalloc(uae_u32, (gb->vram_dirty_pages + 31) / 32);
+	gb->vram_dirty_refresh = 0;
+}
+
+// Writes that bypass the VRAM bank handlers (JIT direct access) can't be
+// tracked, fall back to full refresh in that case.
+static bool gfxboard_vram_dirty_active(struct rtggfxboard *gb)
+{
+	return gb->vram_dirty != NULL && !currprefs.cachesize;
+}
+
+STATIC_INLINE void gfxboard_vram_dirty(struct rtggfxboard *gb, uae_u32 offset, uae_u32 size)
+{
+	if (!gb->vram_dirty || !size)
+		return;
+	uae_u32 page = offset >> VRAM_DIRTY_PAGE_SHIFT;
+	uae_u32 last = (offset + size - 1) >> VRAM_DIRTY_PAGE_SHIFT;
+	if (last >= (uae_u32)gb->vram_dirty_pages)
+		last = gb->vram_dirty_pages - 1;
+	for (; page <= last; page++) {
+		gb->vram_dirty[page >> 5] |= 1 << (page & 31);
+	}
+}
+
+static bool gfxboard_vram_is_dirty(struct rtggfxboard *gb, uae_u32 offset, uae_u32 size)
+{
+	uae_u32 page = offset >> VRAM_DIRTY_PAGE_SHIFT;
+	uae_u32 last = (offset + size - 1) >> VRAM_DIRTY_PAGE_SHIFT;
+	if (last >= (uae_u32)gb->vram_dirty_pages)
+		last = gb->vram_dirty_pages - 1;
+	for (; page <= last; page++) {
+		if (gb->vram_dirty[page >> 5] & (1 << (page & 31)))
+			return true;
+	}
+	return false;
+}
+
+static void gfxboard_vram_clean(struct rtggfxboard *gb, uae_u32 offset, uae_u32 size)
+{
+	uae_u32 page = offset >> VRAM_DIRTY_PAGE_SHIFT;
+	uae_u32 last = (offset + size - 1) >> VRAM_DIRTY_PAGE_SHIFT;
+	if (last >= (uae_u32)gb->vram_dirty_pages)
+		last = gb->vram_dirty_pages - 1;
+	for (; page <= last; page++) {
+		gb->vram_dirty[page >> 5] &= ~(1 << (page & 31));
+	}
+}
+
 static void init_board (struct rtggfxboard *gb)
 {
 	struct rtgboardconfig *rbc = gb->rbc;
@@ -1039,6 +1098,7 @@ static void init_board (struct rtggfxboard *gb)
 	gb->vramrealstart = gb->vram;
 	gb->vram += gb->vram_start_offset;
 	gb->vramend += gb->vram_start_offset;
+	gfxboard_vram_dirty_alloc(gb, vramsize - gb->vram_start_offset);
 	//gb->gfxmem_bank->baseaddr = gb->vram;
 	// restore original value because this is checked against
 	// configured size in expansion.cpp
@@ -1516,14 +1576,17 @@ void qemu_console_resize(QemuConsole *con, int width, int height)
 
 void linear_memory_region_set_dirty(MemoryRegion *mr, hwaddr addr, hwaddr size)
 {
+	struct rtggfxboard *gb = (struct rtggfxboard*)mr->data;
+	gfxboard_vram_dirty(gb, (uae_u32)addr, (uae_u32)size);
 }
 
 void vga_memory_region_set_dirty(MemoryRegion *mr, hwaddr addr, hwaddr size)
 {
 	struct rtggfxboard *gb = (struct rtggfxboard*)mr->data;
+	gfxboard_vram_dirty(gb, (uae_u32)addr, (uae_u32)size);
 	if (gb->vga.vga.graphic_mode != 1)
 		return;
-	if (!gb->fullrefresh) {
+	if (!gb->fullrefresh && !gfxboard_vram_dirty_active(gb)) {
 		gfxboard_set_fullrefresh(gb, 1);
 	}
 }
@@ -1798,7 +1861,13 @@ void gfxboard_vsync_handler(bool full_redraw_required, bool redraw_required)
 
 		if (!gb->monswitch_delay && gb->monswitch_current && ad->picasso_on && ad->picasso_requested_on && !gb->resolutionchange) {
 			if (!gb->pcemdev) {
-				if (picasso_getwritewatch(i, gb->vram_start_offset, NULL, NULL) < 0) {
+				if (gfxboard_vram_dirty_active(gb)) {
+					// catch host side writes (filesys, DMA) that went through xlate
+					if (++gb->vram_dirty_refresh >= VRAM_DIRTY_REFRESH) {
+						gb->vram_dirty_refresh = 0;
+						gb->fullrefresh = 1;
+					}
+				} else if (picasso_getwritewatch(i, gb->vram_start_offset, NULL, NULL) < 0) {
 					gb->fullrefresh = 1;
 				}
 				if (gb->fullrefresh)
@@ -1917,7 +1986,12 @@ void memory_region_set_enabled(MemoryRegion *mr, bool enabled)
 void memory_region_reset_dirty(MemoryRegion *mr, hwaddr addr,
                                hwaddr size, unsigned client)
 {
+	struct rtggfxboard *gb = (struct rtggfxboard*)mr->data;
+	if (mr->opaque != &gb->vgavramregionptr || !gb->vram_dirty)
+		return;
 	//write_log (_T("memory_region_reset_dirty %08x %08x\n"), addr, size);
+	// vga_draw_graphic() passes last - first
+	gfxboard_vram_clean(gb, (uae_u32)addr, (uae_u32)size + 1);
 }
 bool memory_region_get_dirty(MemoryRegion *mr, hwaddr addr,
                              hwaddr size, unsigned client)
@@ -1928,6 +2002,8 @@ bool memory_region_get_dirty(MemoryRegion *mr, hwaddr addr,
 	//write_log (_T("memory_region_get_dirty %08x %08x\n"), addr, size);
 	if (gb->fullrefresh)
 		return true;
+	if (gfxboard_vram_dirty_active(gb))
+		return gfxboard_vram_is_dirty(gb, (uae_u32)addr, (uae_u32)size + 1);
 	return picasso_is_vram_dirty (gb->rtg_index, addr + gb->gfxmem_bank->start, size);
 }
 
@@ -2340,6 +2416,7 @@ static void gfxboard_lput_vram (struct rtggfxboard *gb, uaecptr addr, uae_u32 l,
 		}
 	} else {
 		uae_u8 *m = gb->vram + addr;
+		gfxboard_vram_dirty(gb, addr, 4);
 		if (bs < 0) {
 			*((uae_u16*)(m + 0)) = l >> 16;
 			*((uae_u16*)(m + 2)) = l >>  0;
@@ -2374,6 +2451,7 @@ static void gfxboard_wput_vram (struct rtggfxboard *gb, uaecptr addr, uae_u16 w,
 		}
 	} else {
 		uae_u8 *m = gb->vram + addr;
+		gfxboard_vram_dirty(gb, addr, 2);
 		if (bs)
 			*((uae_u16*)m) = w;
 		else
@@ -2403,6 +2481,7 @@ static void gfxboard_bput_vram (struct rtggfxboard *gb, uaecptr addr, uae_u8 b,
 		else
 			bank->write(&gb->vga, addr, b, 1);
 	} else {
+		gfxboard_vram_dirty(gb, addr, 1);
 		if (bs)
 			gb->vram[addr ^ 1] = b;
 		else
@@ -3473,6 +3552,8 @@ static void gfxboard_free_board(struct rtggfxboard *gb)
 	gb->gfxmem_bank = NULL;
 	gb->vram = NULL;
 	gb->vramrealstart = NULL;
+	xfree(gb->vram_dirty);
+	gb->vram_dirty = NULL;
 	xfree(gb->fakesurface_surface);
 	gb->fakesurface_surface = NULL;
 	xfree(gb->bios);
@@ -737,9 +737,10 @@ int hdf_open (struct hardfiledata *hfd, const TCHAR *pname)
 		hfd->vhd_header = xmalloc (uae_u8, size);
 		if (hdf_read_target (hfd, hfd->vhd_header, 0, size) != size)
 			goto end;
-		hfd->vhd_sectormap = xmalloc (uae_u8, 512);
-		hfd->vhd_sectormapblock = -1;
 		hfd->vhd_bitmapsize = ((hfd->vhd_blocksize / (8 * 512)) + 511) & ~511;
+		// sector bitmaps are loaded on first access and kept for the lifetime of the image
+		hfd->vhd_blocks = (uae_u32)((hfd->virtsize + hfd->vhd_blocksize - 1) / hfd->vhd_blocksize);
+		hfd->vhd_bitmaps = xcalloc (uae_u8*, hfd->vhd_blocks);
 	}
 	write_log (_T("HDF is VHD %s image, virtual size=%lldK (%llx %lld)\n"),
 		hfd->hfd_type == HFD_VHD_FIXED ? _T("fixed") : _T("dynamic"),
@@ -789,8 +790,13 @@ void hdf_close (struct hardfiledata *hfd)
 	hfd->hfd_type = 0;
 	xfree (hfd->vhd_header);
 	hfd->vhd_header = NULL;
-	xfree (hfd->vhd_sectormap);
-	hfd->vhd_sectormap = NULL;
+	if (hfd->vhd_bitmaps) {
+		for (uae_u32 i = 0; i < hfd->vhd_blocks; i++)
+			xfree (hfd->vhd_bitmaps[i]);
+		xfree (hfd->vhd_bitmaps);
+		hfd->vhd_bitmaps = NULL;
+	}
+	hfd->vhd_blocks = 0;
 }
 
 int hdf_dup (struct hardfiledata *dhfd, const struct hardfiledata *shfd)
@@ -798,10 +804,37 @@ int hdf_dup (struct hardfiledata *dhfd, const struct hardfiledata *shfd)
 	return hdf_dup_target (dhfd, shfd);
 }
 
+STATIC_INLINE int vhd_sector_used (const uae_u8 *bm, uae_u32 sector)
+{
+	return bm[sector >> 3] & (1 << (7 - (sector & 7)));
+}
+
+STATIC_INLINE uae_u32 vhd_bat_entry (struct hardfiledata *hfd, uae_u32 blocknum)
+{
+	return gl (hfd->vhd_header + hfd->vhd_bamoffset + blocknum * 4);
+}
+
+// sector bitmap of an allocated block, read from disk once and then cached
+static uae_u8 *vhd_get_bitmap (struct hardfiledata *hfd, uae_u32 blocknum, uae_u32 sectoroffset)
+{
+	uae_u8 *bm = hfd->vhd_bitmaps[blocknum];
+	if (bm)
+		return bm;
+	bm = xmalloc (uae_u8, hfd->vhd_bitmapsize);
+	if (hdf_read_target (hfd, bm, sectoroffset * (uae_u64)512, hfd->vhd_bitmapsize) != (int)hfd->vhd_bitmapsize) {
+		write_log (_T("vhd: bitmap read error, block %u\n"), blocknum);
+		xfree (bm);
+		return NULL;
+	}
+	hfd->vhd_bitmaps[blocknum] = bm;
+	return bm;
+}
+
 static uae_u64 vhd_read (struct hardfiledata *hfd, void *v, uae_u64 offset, uae_u64 len)
 {
 	uae_u64 read;
 	uae_u8 *dataptr = (uae_u8*)v;
+	uae_u32 blocksectors = hfd->vhd_blocksize / 512;
 
 	//write_log (_T("%08x %08x\n"), (uae_u32)offset, (uae_u32)len);
 	read = 0;
@@ -810,84 +843,103 @@ static uae_u64 vhd_read (struct hardfiledata *hfd, void *v, uae_u64 offset, uae_
 	if (len & 511)
 		return read;
 	while (len > 0) {
-		uae_u32 bamoffset = (uae_u32)((offset / hfd->vhd_blocksize) * 4 + hfd->vhd_bamoffset);
-		uae_u32 sectoroffset = gl (hfd->vhd_header + bamoffset);
+		uae_u32 blocknum = (uae_u32)(offset / hfd->vhd_blocksize);
+		uae_u32 sector = (uae_u32)((offset / 512) % blocksectors);
+		uae_u32 count = blocksectors - sector;
+		uae_u32 sectoroffset;
+
+		if (blocknum >= hfd->vhd_blocks)
+			return read;
+		if (count > len / 512)
+			count = (uae_u32)(len / 512);
+		sectoroffset = vhd_bat_entry (hfd, blocknum);
 		if (sectoroffset == 0xffffffff) {
-			memset (dataptr, 0, 512);
-			read += 512;
+			// unallocated block
+			memset (dataptr, 0, count * 512);
 		} else {
-			int bitmapoffsetbits;
-			int bitmapoffsetbytes;
-			uae_u64 sectormapblock;
-
-			bitmapoffsetbits = (offset / 512) % (hfd->vhd_blocksize / 512);
-			bitmapoffsetbytes = bitmapoffsetbits / 8;
-			sectormapblock = sectoroffset * (uae_u64)512 + (bitmapoffsetbytes & ~511);
-			if (hfd->vhd_sectormapblock != sectormapblock) {
-				// read sector bitmap
-				//write_log (_T("BM %08x\n"), sectormapblock);
-				if (hdf_read_target (hfd, hfd->vhd_sectormap, sectormapblock, 512) != 512) {
-					write_log (_T("vhd_read: bitmap read error\n"));
-					return read;
-				}
-				hfd->vhd_sectormapblock = sectormapblock;
-			}
-			// block allocated in bitmap?
-			if (hfd->vhd_sectormap[bitmapoffsetbytes & 511] & (1 << (7 - (bitmapoffsetbits & 7)))) {
-				// read data block
-				uae_u64 block = sectoroffset * (uae_u64)512 + hfd->vhd_bitmapsize + bitmapoffsetbits * 512;
-				//write_log (_T("DB %08x\n"), block);
-				if (hdf_read_target (hfd, dataptr, block, 512) != 512) {
-					write_log (_T("vhd_read: data read error\n"));
-					return read;
+			uae_u8 *bm = vhd_get_bitmap (hfd, blocknum, sectoroffset);
+			uae_u64 data = sectoroffset * (uae_u64)512 + hfd->vhd_bitmapsize;
+			uae_u32 i = 0;
+
+			if (!bm)
+				return read;
+			// split the chunk into runs of allocated and unallocated sectors
+			while (i < count) {
+				int used = vhd_sector_used (bm, sector + i) != 0;
+				uae_u32 run = 1;
+				while (i + run < count && (vhd_sector_used (bm, sector + i + run) != 0) == used)
+					run++;
+				if (used) {
+					if (hdf_read_target (hfd, dataptr + i * 512, data + (sector + i) * (uae_u64)512, run * 512) != (int)(run * 512)) {
+						write_log (_T("vhd_read: data read error\n"));
+						return read + i * 512;
+					}
+				} else {
+					memset (dataptr + i * 512, 0, run * 512);
 				}
-			} else {
-				memset (dataptr, 0, 512);
+				i += run;
 			}
-			read += 512;
 		}
-		len -= 512;
-		dataptr += 512;
-		offset += 512;
+		read += count * 512;
+		len -= count * 512;
+		dataptr += count * 512;
+		offset += count * 512;
 	}
 	return read;
 }
 
-static int vhd_write_enlarge (struct hardfiledata *hfd, uae_u32 bamoffset)
+// allocate 'count' consecutive BAT entries starting from 'blocknum' with a single resize
+static int vhd_write_enlarge (struct hardfiledata *hfd, uae_u32 blocknum, uae_u32 count)
 {
-	uae_u8 *buf, *p;
-	int len;
-	uae_u32 block;
+	uae_u64 blocklen = hfd->vhd_bitmapsize + (uae_u64)hfd->vhd_blocksize;
+	uae_u64 footer = hfd->vhd_footerblock + blocklen * count;
+	uae_u32 batstart, batend;
+	uae_u8 *buf;
 	int v;
 
-	len = hfd->vhd_blocksize + hfd->vhd_bitmapsize + 512;
-	buf = xcalloc (uae_u8, len);
-	if (!hdf_resize_target (hfd, hfd->physsize + len - 512)) {
+	if (!hdf_resize_target (hfd, footer + 512)) {
 		write_log (_T("vhd_enlarge: failure\n"));
-		xfree(buf);
 		return 0;
 	}
-	// add footer (same as 512 byte header)
-	memcpy (buf + len - 512, hfd->vhd_header, 512);
-	v = hdf_write_target (hfd, buf, hfd->vhd_footerblock, len);
+	// new blocks only need an empty sector bitmap, the data area is never
+	// read before the bitmap marks a sector as written.
+	buf = xcalloc (uae_u8, hfd->vhd_bitmapsize);
+	for (uae_u32 i = 0; i < count; i++) {
+		uae_u64 pos = hfd->vhd_footerblock + blocklen * i;
+		if (hdf_write_target (hfd, buf, pos, hfd->vhd_bitmapsize) != (int)hfd->vhd_bitmapsize) {
+			write_log (_T("vhd_enlarge: bitmap write error\n"));
+			xfree (buf);
+			return 0;
+		}
+	}
 	xfree (buf);
-	if (v != len) {
+	// add footer (same as 512 byte header)
+	v = hdf_write_target (hfd, hfd->vhd_header, footer, 512);
+	if (v != 512) {
 		write_log (_T("vhd_enlarge: footer write error\n"));
 		return 0;
 	}
-	// write new offset to BAM
-	p = hfd->vhd_header + bamoffset;
-	block = (uae_u32)(hfd->vhd_footerblock / 512);
-	p[0] = block >> 24;
-	p[1] = block >> 16;
-	p[2] = block >>  8;
-	p[3] = block >>  0;
-	// write to disk
-	if (hdf_write_target (hfd, hfd->vhd_header + hfd->vhd_bamoffset, hfd->vhd_bamoffset, hfd->vhd_bamsize) != hfd->vhd_bamsize) {
+	// write new offsets to BAM
+	for (uae_u32 i = 0; i < count; i++) {
+		uae_u8 *p = hfd->vhd_header + hfd->vhd_bamoffset + (blocknum + i) * 4;
+		uae_u32 block = (uae_u32)((hfd->vhd_footerblock + blocklen * i) / 512);
+		p[0] = block >> 24;
+		p[1] = block >> 16;
+		p[2] = block >>  8;
+		p[3] = block >>  0;
+		xfree (hfd->vhd_bitmaps[blocknum + i]);
+		hfd->vhd_bitmaps[blocknum + i] = xcalloc (uae_u8, hfd->vhd_bitmapsize);
+	}
+	// write to disk, only the BAM sectors that changed
+	batstart = (blocknum * 4) & ~511;
+	batend = ((blocknum + count) * 4 + 511) & ~511;
+	if (batend > hfd->vhd_bamsize)
+		batend = hfd->vhd_bamsize;
+	if (hdf_write_target (hfd, hfd->vhd_header + hfd->vhd_bamoffset + batstart, hfd->vhd_bamoffset + batstart, batend - batstart) != (int)(batend - batstart)) {
 		write_log (_T("vhd_enlarge: bam write error\n"));
 		return 0;
 	}
-	hfd->vhd_footerblock += len - 512;
+	hfd->vhd_footerblock = footer;
 	return 1;
 }
 
@@ -895,6 +947,7 @@ static uae_u64 vhd_write (struct hardfiledata *hfd, void *v, uae_u64 offset, uae
 {
 	uae_u64 written;
 	uae_u8 *dataptr = (uae_u8*)v;
+	uae_u32 blocksectors = hfd->vhd_blocksize / 512;
 
 	//write_log (_T("%08x %08x\n"), (uae_u32)offset, (uae_u32)len);
 	written = 0;
@@ -903,51 +956,64 @@ static uae_u64 vhd_write (struct hardfiledata *hfd, void *v, uae_u64 offset, uae
 	if (len & 511)
 		return written;
 	while (len > 0) {
-		uae_u32 bamoffset = (uae_u32)((offset / hfd->vhd_blocksize) * 4 + hfd->vhd_bamoffset);
-		uae_u32 sectoroffset = gl (hfd->vhd_header + bamoffset);
+		uae_u32 blocknum = (uae_u32)(offset / hfd->vhd_blocksize);
+		uae_u32 sector = (uae_u32)((offset / 512) % blocksectors);
+		uae_u32 count = blocksectors - sector;
+		uae_u32 sectoroffset;
+		int first, last;
+		uae_u8 *bm;
+
+		if (blocknum >= hfd->vhd_blocks)
+			return written;
+		if (count > len / 512)
+			count = (uae_u32)(len / 512);
+		sectoroffset = vhd_bat_entry (hfd, blocknum);
 		if (sectoroffset == 0xffffffff) {
-			if (!vhd_write_enlarge (hfd, bamoffset))
+			// allocate all unallocated blocks this request covers at once
+			uae_u32 lastblock = (uae_u32)((offset + len - 1) / hfd->vhd_blocksize);
+			uae_u32 n = 1;
+			if (lastblock >= hfd->vhd_blocks)
+				lastblock = hfd->vhd_blocks - 1;
+			while (blocknum + n <= lastblock && vhd_bat_entry (hfd, blocknum + n) == 0xffffffff)
+				n++;
+			if (!vhd_write_enlarge (hfd, blocknum, n))
 				return written;
 			continue;
-		} else {
-			int bitmapoffsetbits;
-			int bitmapoffsetbytes;
-
-			bitmapoffsetbits = (offset / 512) % (hfd->vhd_blocksize / 512);
-			bitmapoffsetbytes = bitmapoffsetbits / 8;
-			uae_u64 sectormapblock = sectoroffset * (uae_u64)512 + (bitmapoffsetbytes & ~511);
-			if (hfd->vhd_sectormapblock != sectormapblock) {
-				// read sector bitmap
-				if (hdf_read_target (hfd, hfd->vhd_sectormap, sectormapblock, 512) != 512) {
-					write_log (_T("vhd_write: bitmap read error\n"));
-					return written;
-				}
-				hfd->vhd_sectormapblock = sectormapblock;
+		}
+		bm = vhd_get_bitmap (hfd, blocknum, sectoroffset);
+		if (!bm)
+			return written;
+		// write data
+		if (hdf_write_target (hfd, dataptr, sectoroffset * (uae_u64)512 + hfd->vhd_bitmapsize + sector * (uae_u64)512, count * 512) != (int)(count * 512)) {
+			write_log (_T("vhd_write: data write error\n"));
+			return written;
+		}
+		// mark new sectors allocated and write back the modified part of the bitmap
+		first = last = -1;
+		for (uae_u32 i = sector; i < sector + count; i++) {
+			if (!vhd_sector_used (bm, i)) {
+				bm[i >> 3] |= 1 << (7 - (i & 7));
+				if (first < 0)
+					first = i;
+				last = i;
 			}
-			// write data
-			if (hdf_write_target (hfd, dataptr, sectoroffset * (uae_u64)512 + hfd->vhd_bitmapsize + bitmapoffsetbits * 512, 512) != 512) {
-				write_log (_T("vhd_write: data write error\n"));
+		}
+		if (first >= 0) {
+			uae_u32 start = (first / 8) & ~511;
+			uae_u32 end = (last / 8 + 512) & ~511;
+			if (hdf_write_target (hfd, bm + start, sectoroffset * (uae_u64)512 + start, end - start) != (int)(end - start)) {
+				write_log (_T("vhd_write: bam write error\n"));
 				return written;
 			}
-			// block already allocated in bitmap?
-			if (!(hfd->vhd_sectormap[bitmapoffsetbytes & 511] & (1 << (7 - (bitmapoffsetbits & 7))))) {
-				// no, we need to mark it allocated and write the modified bitmap back to the disk
-				hfd->vhd_sectormap[bitmapoffsetbytes & 511] |= (1 << (7 - (bitmapoffsetbits & 7)));
-				if (hdf_write_target (hfd, hfd->vhd_sectormap, sectormapblock, 512) != 512) {
-					write_log (_T("vhd_write: bam write error\n"));
-					return written;
-				}
-			}
-			written += 512;
 		}
-		len -= 512;
-		dataptr += 512;
-		offset += 512;
+		written += count * 512;
+		len -= count * 512;
+		dataptr += count * 512;
+		offset += count * 512;
 	}
 	return written;
 }
 
-
 int vhd_create (const TCHAR *name, uae_u64 size, uae_u32 dostype)
 {
 	struct hardfiledata hfd;
@@ -1310,15 +1376,10 @@ static uae_u64 cmd_read(TrapContext *ctx, struct hardfiledata *hfd, uaecptr data
 {
 	if (!len || len > INT_MAX)
 		return 0;
-	if (!ctx && real_address_allowed()) {
-		addrbank *bank_data = &get_mem_bank (dataptr);
-		if (!bank_data)
-			return 0;
-		if (bank_data->check(dataptr, (uae_u32)len)) {
-			uae_u8 *buffer = bank_data->xlateaddr(dataptr);
-			return cmd_readx(hfd, buffer, offset, (uae_u32)len);
-		}
-	}
+	// plain RAM: transfer directly, also with indirect traps
+	uae_u8 *buffer = trap_get_host_address(ctx, dataptr, (uae_u32)len);
+	if (buffer)
+		return cmd_readx(hfd, buffer, offset, len);
 	int total = 0;
 	while (len > 0) {
 		uae_u8 buf[RTAREA_TRAP_DATA_EXTRA_SIZE];
@@ -1347,15 +1408,10 @@ static uae_u64 cmd_write(TrapContext *ctx, struct hardfiledata *hfd, uaecptr dat
 {
 	if (!len || len > INT_MAX)
 		return 0;
-	if (!ctx && real_address_allowed()) {
-		addrbank *bank_data = &get_mem_bank (dataptr);
-		if (!bank_data)
-			return 0;
-		if (bank_data->check(dataptr, (uae_u32)len)) {
-			uae_u8 *buffer = bank_data->xlateaddr(dataptr);
-			return cmd_writex(hfd, buffer, offset, len);
-		}
-	}
+	// plain RAM: transfer directly, also with indirect traps
+	uae_u8 *buffer = trap_get_host_address(ctx, dataptr, (uae_u32)len);
+	if (buffer)
+		return cmd_writex(hfd, buffer, offset, len);
 	int total = 0;
 	while (len > 0) {
 		uae_u8 buf[RTAREA_TRAP_DATA_EXTRA_SIZE];
@@ -54,6 +54,11 @@ typedef bool(*SOUND_STREAM_CALLBACK)(int, void*);
 
 extern int audio_enable_stream(bool, int, int, SOUND_STREAM_CALLBACK, void*);
 extern void audio_state_stream_state(int, int*, int, unsigned int);
+extern int audio_enable_block_stream(int ch, float evt, SOUND_STREAM_CALLBACK cb, void *cb_data);
+extern void audio_stream_block_rate(int streamid, float evt);
+extern int audio_write_stream_block(int streamid, const uae_s16 *data, int frames, const int *volume);
+extern int audio_stream_block_fill(int streamid);
+extern uae_u32 audio_stream_block_position(int streamid);
 
 struct cd_audio_state
 {
@@ -63,6 +68,7 @@ struct cd_audio_state
 	void *cb_data;
 	int cda_volume[2];
 	int cda_streamid = -1;
+	bool cda_pending = false;
 };
 
 extern void audio_cda_new_buffer(struct cd_audio_state *cas, uae_s16 *buffer, int length, int userdata, CDA_CALLBACK next_cd_audio_buffer_callback, void *cb_data);
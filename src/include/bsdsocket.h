@@ -84,6 +84,7 @@ struct socketbase {
 	uae_sem_t sem;		/* semaphore to notify the socket thread of work */
 	uae_thread_id thread;	/* socket thread */
 	int  sockabort[2];		/* pipe used to tell the thread to abort a select */
+	int epollfd;		/* readiness of sockets this thread has blocked on (Linux) */
 	int action;
 	int s;			/* for accept */
 	uae_u32 name;		/* For gethostbyname */
@@ -21,39 +21,69 @@ typedef union {
  * time, but it wouldn't be hard to use a "normal" pipe as an extension once the
  * user-level one gets full.
  * We queue up to chunks pieces of data before signalling the other thread to
- * avoid overhead. */
+ * avoid overhead.
+ *
+ * Each pipe has exactly one reader and one writer thread at a time (callers
+ * with several writers, such as native2amiga, serialize them themselves), so
+ * the ring is lock-free: the writer owns wrp, the reader owns rdp, and they
+ * are published with release/acquire ordering. The semaphores are only
+ * touched when the reader finds the pipe empty or the writer finds it full. */
+
+/* Telemetry counters of one pipe. They live in a table owned by the
+ * telemetry code, so sampling them never touches pipe memory, which may
+ * already be freed; pipe is only compared, never dereferenced. */
+struct comm_pipe_telemetry {
+	const void *pipe;
+	const char *name;
+	int depth, hwm, hwm_total;
+};
 
 typedef struct {
-	uae_sem_t lock;
 	uae_sem_t reader_wait;
 	uae_sem_t writer_wait;
 	uae_pt *data;
-	int size, chunks;
-	volatile int rdp, wrp;
-	volatile int writer_waiting;
-	volatile int reader_waiting;
+	int size, mask, chunks;
+	int rdp, wrp;
+	int writer_waiting;
+	int reader_waiting;
+	const char *name;
+	/* NULL unless thread telemetry is on */
+	struct comm_pipe_telemetry *telemetry;
 } smp_comm_pipe;
 
-STATIC_INLINE void init_comm_pipe (smp_comm_pipe *p, int size, int chunks)
+void uae_telemetry_add_pipe (smp_comm_pipe *p);
+void uae_telemetry_remove_pipe (smp_comm_pipe *p);
+
+/* pipes are named after the place that creates them */
+#define init_comm_pipe(p, size, chunks) init_comm_pipe_named (p, size, chunks, __FILE__ ":" UAE_COMM_PIPE_STR(__LINE__))
+#define UAE_COMM_PIPE_STR(x) UAE_COMM_PIPE_STR2(x)
+#define UAE_COMM_PIPE_STR2(x) #x
+
+STATIC_INLINE void init_comm_pipe_named (smp_comm_pipe *p, int size, int chunks, const char *name)
 {
+	int ringsize = 2;
+	/* one slot always stays free to tell full from empty */
+	while (ringsize < size + 1)
+		ringsize <<= 1;
 	memset (p, 0, sizeof (*p));
-	p->data = (uae_pt *)malloc (size*sizeof (uae_pt));
-	p->size = size;
+	p->data = (uae_pt *)malloc (ringsize*sizeof (uae_pt));
+	p->size = ringsize;
+	p->mask = ringsize - 1;
 	p->chunks = chunks;
 	p->rdp = p->wrp = 0;
 	p->reader_waiting = 0;
 	p->writer_waiting = 0;
-	uae_sem_init (&p->lock, 0, 1);
+	p->name = name;
 	uae_sem_init (&p->reader_wait, 0, 0);
 	uae_sem_init (&p->writer_wait, 0, 0);
+	uae_telemetry_add_pipe (p);
 }
 
 STATIC_INLINE void destroy_comm_pipe (smp_comm_pipe *p)
 {
-	uae_sem_destroy (&p->lock);
+	uae_telemetry_remove_pipe (p);
 	uae_sem_destroy (&p->reader_wait);
 	uae_sem_destroy (&p->writer_wait);
-	p->lock = 0;
 	p->reader_wait = 0;
 	p->writer_wait = 0;
 	if(p->size > 0 && p->data != NULL)
@@ -64,69 +94,77 @@ STATIC_INLINE void destroy_comm_pipe (smp_comm_pipe *p)
 	}
 }
 
-STATIC_INLINE void maybe_wake_reader (smp_comm_pipe *p, int no_buffer)
+/* Sleep on sem until the other side has made progress. waiting is raised
+ * before re-checking the condition; if the condition already went away we
+ * take the flag back, or, when the other side beat us to it, swallow the
+ * post it has made or is about to make. */
+STATIC_INLINE void comm_pipe_wait (uae_sem_t *sem, int *waiting, int *other_idx, int idx)
 {
-	if (p->reader_waiting && (no_buffer || ((p->wrp - p->rdp + p->size) % p->size) >= p->chunks)) {
-		p->reader_waiting = 0;
-		uae_sem_post (&p->reader_wait);
+	__atomic_store_n (waiting, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n (other_idx, __ATOMIC_SEQ_CST) != idx) {
+		if (__atomic_exchange_n (waiting, 0, __ATOMIC_SEQ_CST))
+			return;
 	}
+	uae_sem_wait (sem);
 }
 
-STATIC_INLINE void write_comm_pipe_pt (smp_comm_pipe *p, uae_pt data, int no_buffer)
+STATIC_INLINE void comm_pipe_wake (uae_sem_t *sem, int *waiting)
 {
-	int nxwrp = (p->wrp + 1) % p->size;
+	if (__atomic_load_n (waiting, __ATOMIC_SEQ_CST) && __atomic_exchange_n (waiting, 0, __ATOMIC_SEQ_CST))
+		uae_sem_post (sem);
+}
 
-	if (p->reader_waiting) {
-		/* No need to do all the locking */
-		p->data[p->wrp] = data;
-		p->wrp = nxwrp;
-		maybe_wake_reader (p, no_buffer);
+STATIC_INLINE void maybe_wake_reader (smp_comm_pipe *p, int no_buffer)
+{
+	if (!__atomic_load_n (&p->reader_waiting, __ATOMIC_SEQ_CST))
 		return;
-	}
+	if (no_buffer || ((p->wrp - __atomic_load_n (&p->rdp, __ATOMIC_ACQUIRE)) & p->mask) >= p->chunks)
+		comm_pipe_wake (&p->reader_wait, &p->reader_waiting);
+}
 
-	uae_sem_wait (&p->lock);
-	if (nxwrp == p->rdp) {
-		/* Pipe full! */
-		p->writer_waiting = 1;
-		uae_sem_post (&p->lock);
-		/* Note that the reader could get in between here and do a
-		 * sem_post on writer_wait before we wait on it. That's harmless.
-		 * There's a similar case in read_comm_pipe_int_blocking. */
-		uae_sem_wait (&p->writer_wait);
-		uae_sem_wait (&p->lock);
+STATIC_INLINE void write_comm_pipe_pt (smp_comm_pipe *p, uae_pt data, int no_buffer)
+{
+	int wrp = p->wrp;
+	int nxwrp = (wrp + 1) & p->mask;
+
+	/* Pipe full! Wait for the reader to consume something. */
+	while (nxwrp == __atomic_load_n (&p->rdp, __ATOMIC_ACQUIRE))
+		comm_pipe_wait (&p->writer_wait, &p->writer_waiting, &p->rdp, nxwrp);
+
+	if (p->telemetry) {
+		struct comm_pipe_telemetry *t = p->telemetry;
+		int depth = (nxwrp - __atomic_load_n (&p->rdp, __ATOMIC_RELAXED)) & p->mask;
+		int hwm = __atomic_load_n (&t->hwm, __ATOMIC_RELAXED);
+		while (depth > hwm && !__atomic_compare_exchange_n (&t->hwm, &hwm, depth, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			;
+		__atomic_store_n (&t->depth, depth, __ATOMIC_RELAXED);
 	}
-	p->data[p->wrp] = data;
-	p->wrp = nxwrp;
+	p->data[wrp] = data;
+	__atomic_store_n (&p->wrp, nxwrp, __ATOMIC_SEQ_CST);
 	maybe_wake_reader (p, no_buffer);
-	uae_sem_post (&p->lock);
 }
 
 STATIC_INLINE uae_pt read_comm_pipe_pt_blocking (smp_comm_pipe *p)
 {
 	uae_pt data;
+	int rdp = p->rdp;
 
-	uae_sem_wait (&p->lock);
-	if (p->rdp == p->wrp) {
-		p->reader_waiting = 1;
-		uae_sem_post (&p->lock);
-		uae_sem_wait (&p->reader_wait);
-		uae_sem_wait (&p->lock);
-	}
-	data = p->data[p->rdp];
-	p->rdp = (p->rdp + 1) % p->size;
+	while (rdp == __atomic_load_n (&p->wrp, __ATOMIC_ACQUIRE))
+		comm_pipe_wait (&p->reader_wait, &p->reader_waiting, &p->wrp, rdp);
+
+	data = p->data[rdp];
+	__atomic_store_n (&p->rdp, (rdp + 1) & p->mask, __ATOMIC_SEQ_CST);
+	if (p->telemetry)
+		__atomic_store_n (&p->telemetry->depth, (__atomic_load_n (&p->wrp, __ATOMIC_RELAXED) - rdp - 1) & p->mask, __ATOMIC_RELAXED);
 
 	/* We ignore chunks here. If this is a problem, make the size bigger in the init call. */
-	if (p->writer_waiting) {
-		p->writer_waiting = 0;
-		uae_sem_post (&p->writer_wait);
-	}
-	uae_sem_post (&p->lock);
+	comm_pipe_wake (&p->writer_wait, &p->writer_waiting);
 	return data;
 }
 
 STATIC_INLINE int comm_pipe_has_data (smp_comm_pipe *p)
 {
-	return p->rdp != p->wrp;
+	return __atomic_load_n (&p->rdp, __ATOMIC_ACQUIRE) != __atomic_load_n (&p->wrp, __ATOMIC_ACQUIRE);
 }
 
 STATIC_INLINE int read_comm_pipe_int_blocking (smp_comm_pipe *p)
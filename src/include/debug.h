@@ -164,7 +164,7 @@ extern struct breakpoint_node bpnodes[BREAKPOINT_TOTAL];
 #define MW_MASK_NONE			0x80000000
 #define MW_MASK_ALL				(MW_MASK_NONE - 1)
 
-#define MEMWATCH_TOTAL 20
+#define MEMWATCH_TOTAL 128
 struct memwatch_node {
 	uaecptr addr;
 	int size;
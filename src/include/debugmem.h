@@ -13,6 +13,8 @@ void debugmem_disable(void);
 void debugmem_enable(void);
 int debugmem_get_segment(uaecptr addr, bool *exact, bool *ext, TCHAR *out, TCHAR *name);
 int debugmem_get_symbol(uaecptr addr, TCHAR *out, int maxsize);
+bool debugmem_get_symbol_nearest(uaecptr addr, TCHAR *out, int maxsize, uaecptr *basep);
+void debugmem_symbol_index(bool build);
 bool debugmem_get_symbol_value(const TCHAR *name, uae_u32 *valp);
 bool debugmem_list_segment(int mode, uaecptr addr);
 int debugmem_get_sourceline(uaecptr addr, TCHAR *out, int maxsize);
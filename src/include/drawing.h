@@ -371,6 +371,10 @@ extern void drawing_init (void);
 extern bool notice_interlace_seen(int, bool);
 extern void notice_resolution_seen(int, bool);
 extern bool frame_drawn (int monid);
+#ifdef AMIBERRY
+extern bool warp_present_active(void);
+extern bool warp_present_skipped(void);
+#endif
 extern void redraw_frame(void);
 extern void full_redraw_all(void);
 extern bool draw_frame (struct vidbuffer*);
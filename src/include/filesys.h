@@ -57,8 +57,8 @@ struct hardfiledata {
     uae_u32 vhd_bamoffset;
     uae_u32 vhd_bamsize;
     uae_u32 vhd_blocksize;
-    uae_u8 *vhd_sectormap;
-    uae_u64 vhd_sectormapblock;
+    uae_u8 **vhd_bitmaps;
+    uae_u32 vhd_blocks;
     uae_u32 vhd_bitmapsize;
     uae_u64 vhd_footerblock;
 
@@ -159,6 +159,8 @@ extern uae_s64 my_lseek (struct my_openfile_s*, uae_s64, int);
 extern uae_s64 my_fsize (struct my_openfile_s*);
 extern unsigned int my_read (struct my_openfile_s*, void*, unsigned int);
 extern unsigned int my_write (struct my_openfile_s*, void*, unsigned int);
+extern int my_pread (struct my_openfile_s*, void*, unsigned int, uae_u64);
+extern int my_pwrite (struct my_openfile_s*, void*, unsigned int, uae_u64);
 extern int my_truncate (const TCHAR *name, uae_u64 len);
 extern int dos_errno (void);
 extern bool my_existslink(const char* name);
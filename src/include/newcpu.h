@@ -732,6 +732,17 @@ extern int get_cpu_model (void);
 extern void set_cpu_caches (bool flush);
 extern void flush_cpu_caches(bool flush);
 extern void flush_cpu_caches_040(uae_u16 opcode);
+
+/* Predecoded instruction cache of the non-prefetch 68020+ loop
+ * (amiberry.conf cpu_predecode). cpu_predecode_pages is NULL when off. */
+extern uae_u8 *cpu_predecode_pages;
+extern void cpu_predecode_written(uaecptr addr, int size);
+extern void cpu_predecode_flush(void);
+STATIC_INLINE void cpu_predecode_write(uaecptr addr, int size)
+{
+	if (cpu_predecode_pages)
+		cpu_predecode_written(addr, size);
+}
 extern void REGPARAM3 MakeSR (void) REGPARAM;
 extern void REGPARAM3 MakeFromSR(void) REGPARAM;
 extern void REGPARAM3 MakeFromSR_T0(void) REGPARAM;
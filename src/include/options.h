@@ -1369,6 +1369,33 @@ struct amiberry_options
 	char gui_theme_selection_color[128] = "195, 217, 217";
 	char gui_theme_foreground_color[128] = "0, 0, 0";
 	char gui_theme_font_color[128] = "0, 0, 0";
+	// CPU lists ("2", "2-3", "0,2") per thread role, empty = no pinning
+	char thread_affinity_emulation[128]{};
+	char thread_affinity_drawing[128]{};
+	char thread_affinity_audio[128]{};
+	char thread_affinity_io[128]{};
+	// "none", "fifo" or "rr" for emulation, drawing and audio threads
+	char thread_rt_policy[128] = "none";
+	int thread_rt_priority = 10;
+	int thread_io_nice = 0;
+	// per-thread CPU/wakeup and queue depth sampling, once per second
+	bool thread_telemetry = false;
+	bool thread_telemetry_overlay = false;
+	char thread_telemetry_file[256]{};
+	// per-instance copy-on-write deltas for writable hardfiles, empty = off
+	char hardfile_overlay_dir[256]{};
+	// what happens to the delta on close: "keep", "discard" or "commit"
+	char hardfile_overlay_close[16] = "keep";
+	// read-ahead and write-behind for files on directory mounted drives
+	bool filesys_buffering = false;
+	// packet worker threads per directory mounted drive, 0 = one packet at a time
+	int filesys_workers = 0;
+	// warp mode: draw and present at this many frames per wall-clock second, 0 = every gfx_framerate frames
+	int warp_present_rate = 0;
+	// predecoded instruction cache for the 68020+ interpreter when not cycle exact, compatible or JIT
+	bool cpu_predecode = false;
+	// serial port and TCP serial traffic through a poll() thread instead of direct calls
+	bool serial_io_thread = true;
 };
 
 extern struct amiberry_options amiberry_options;
@@ -96,6 +96,7 @@ void call_hardware_trap(uae_u8*, uaecptr, int);
 void trap_set_background(TrapContext *ctx);
 void trap_background_set_complete(TrapContext *ctx);
 bool trap_valid_address(TrapContext *ctx, uaecptr addr, uae_u32 size);
+uae_u8 *trap_get_host_address(TrapContext *ctx, uaecptr addr, uae_u32 size);
 bool trap_valid_string(TrapContext *ctx, uaecptr addr, uae_u32 maxsize);
 bool trap_is_indirect(void);
 void trap_dos_active(void);
@@ -75,6 +75,7 @@ struct zvolume
     uae_s64 size;
     unsigned int id;
     uae_s64 archivesize;
+    time_t archivemtime;
     unsigned int method;
     TCHAR *volumename;
     int zfdmask;
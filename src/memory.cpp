@@ -568,8 +568,8 @@ uae_u8 *REGPARAM3 sub_bank_xlate(uaecptr addr) REGPARAM
 
 /* Chip memory */
 
-static uae_u32 chipmem_full_mask;
-static uae_u32 chipmem_full_size;
+uae_u32 chipmem_full_mask;
+uae_u32 chipmem_full_size;
 
 static int REGPARAM3 chipmem_check (uaecptr addr, uae_u32 size) REGPARAM;
 static uae_u8 *REGPARAM3 chipmem_xlate (uaecptr addr) REGPARAM;
@@ -3507,6 +3507,7 @@ static void map_banks2 (addrbank *bank, int start, int size, int realsize, int q
 		old = debug_bankchange (-1);
 #endif
 	flush_icache(3); /* Sure don't want to keep any old mappings around! */
+	cpu_predecode_flush();
 #ifdef NATMEM_OFFSET
 	if (!quick)
 		delete_shmmaps (start << 16, size << 16);
@@ -4140,6 +4141,7 @@ uae_u32 memory_get_byte(uaecptr addr)
 void memory_put_long(uaecptr addr, uae_u32 v)
 {
 	addrbank *ab = &get_mem_bank(addr);
+	cpu_predecode_write(addr, 4);
 	if (!ab->baseaddr_direct_w) {
 		call_mem_put_func(ab->lput, addr, v);
 	} else {
@@ -4153,6 +4155,7 @@ void memory_put_long(uaecptr addr, uae_u32 v)
 void memory_put_word(uaecptr addr, uae_u32 v)
 {
 	addrbank *ab = &get_mem_bank(addr);
+	cpu_predecode_write(addr, 2);
 	if (!ab->baseaddr_direct_w) {
 		call_mem_put_func(ab->wput, addr, v);
 	} else {
@@ -4166,6 +4169,7 @@ void memory_put_word(uaecptr addr, uae_u32 v)
 void memory_put_byte(uaecptr addr, uae_u32 v)
 {
 	addrbank *ab = &get_mem_bank(addr);
+	cpu_predecode_write(addr, 1);
 	if (!ab->baseaddr_direct_w) {
 		call_mem_put_func(ab->bput, addr, v);
 	} else {
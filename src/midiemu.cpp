@@ -10,6 +10,7 @@
 #include <mt32emu.h>
 #include "midiemu.h"
 #include "parser.h"
+#include "threaddep/thread.h"
 
 // MUNT MT-32/CM-32L emulation
 
@@ -20,6 +21,20 @@ static int midi_evt_time;
 static int midi_emu_freq;
 int midi_emu;
 
+// The synth renders blocks of frames on its own thread and queues them to
+// an audio block stream that the mixer drains. MIDI input is timestamped
+// MIDI_EMU_LATENCY frames after the current mixer position and the render
+// thread is never allowed to run further ahead than that, so all events
+// play with the same fixed delay.
+#define MIDI_EMU_BLOCK 256
+#define MIDI_EMU_LATENCY (2 * MIDI_EMU_BLOCK)
+
+static mt32emu_bit16s midi_emu_block[MIDI_EMU_BLOCK * 2];
+static volatile int midi_emu_wakeup;
+static volatile bool midi_emu_thread_quit;
+static uae_sem_t midi_emu_sem;
+static uae_thread_id midi_emu_tid;
+
 static const TCHAR* cm32lctl[] = {
 		_T("cm32l_control"),
 		_T("ctrl_cm32l"),
@@ -209,8 +224,66 @@ bool midi_emu_available(const TCHAR *id)
 void midi_update_sound(float v)
 {
 	base_midi_emu_event = v;
+	if (midi_emu_tid && midi_emu_streamid)
+		audio_stream_block_rate(midi_emu_streamid, base_midi_emu_event * CYCLE_UNIT / midi_emu_freq);
+}
+
+static int midi_emu_thread(void *v)
+{
+	for (;;) {
+		uae_sem_wait(&midi_emu_sem);
+		if (midi_emu_thread_quit)
+			break;
+		__atomic_store_n(&midi_emu_wakeup, 0, __ATOMIC_SEQ_CST);
+		while (audio_stream_block_fill(midi_emu_streamid) <= MIDI_EMU_LATENCY - MIDI_EMU_BLOCK) {
+			int vol = (100 - currprefs.sound_volume_midi) * 32768 / 100;
+			int volume[2] = { vol, vol };
+			mt32emu_render_bit16s(mt32context, midi_emu_block, MIDI_EMU_BLOCK);
+			audio_write_stream_block(midi_emu_streamid, midi_emu_block, MIDI_EMU_BLOCK, volume);
+		}
+	}
+	return 0;
+}
+
+static void midi_emu_wake(void)
+{
+	if (!__atomic_exchange_n(&midi_emu_wakeup, 1, __ATOMIC_SEQ_CST))
+		uae_sem_post(&midi_emu_sem);
+}
+
+static void midi_emu_start_thread(void)
+{
+	midi_emu_wakeup = 0;
+	midi_emu_thread_quit = false;
+	uae_sem_init(&midi_emu_sem, 0, 0);
+	if (!uae_start_thread(_T("mt32emu"), midi_emu_thread, NULL, &midi_emu_tid)) {
+		uae_sem_destroy(&midi_emu_sem);
+		return;
+	}
+	midi_emu_wake();
+}
+
+static void midi_emu_stop_thread(void)
+{
+	if (!midi_emu_tid)
+		return;
+	midi_emu_thread_quit = true;
+	uae_sem_post(&midi_emu_sem);
+	uae_wait_thread(&midi_emu_tid);
+	uae_sem_destroy(&midi_emu_sem);
+}
+
+// block stream refill, the mixer wants more frames
+static bool audio_state_midi_emu_block(int streamid, void *params)
+{
+	if (!mt32context || !midi_emu_tid)
+		return false;
+	if (audio_stream_block_fill(streamid) <= MIDI_EMU_LATENCY - MIDI_EMU_BLOCK)
+		midi_emu_wake();
+	return true;
 }
 
+// no render thread: one frame per stream event
 static bool audio_state_midi_emu(int streamid, void *params)
 {
 	int sample[2] = { 0 };
@@ -231,13 +304,20 @@ static bool audio_state_midi_emu(int streamid, void *params)
 void midi_emu_parse(uae_u8 *midi, int len)
 {
 	if (mt32context) {
-		mt32emu_parse_stream(mt32context, midi, len);
+		if (midi_emu_tid) {
+			mt32emu_bit32u ts = mt32emu_convert_output_to_synth_timestamp(mt32context, audio_stream_block_position(midi_emu_streamid) + MIDI_EMU_LATENCY);
+			mt32emu_parse_stream_at(mt32context, midi, len, ts);
+		} else {
+			mt32emu_parse_stream(mt32context, midi, len);
+		}
 	}
 }
 
 void midi_emu_close(void)
 {
 	midi_emu = 0;
+	// render thread first, it writes to the stream
+	midi_emu_stop_thread();
 	if (midi_emu_streamid) {
 		audio_enable_stream(false, midi_emu_streamid, 0, NULL, NULL);
 		midi_emu_streamid = 0;
@@ -286,7 +366,14 @@ int midi_emu_open(const TCHAR *id)
 	}
 	midi_emu_freq = mt32emu_get_actual_stereo_output_samplerate(mt32context);
 	write_log("mt32emu frequency: %d\n", midi_emu_freq);
-	midi_emu_streamid = audio_enable_stream(true, -1, 2, audio_state_midi_emu, NULL);
+	midi_emu_streamid = audio_enable_block_stream(2, base_midi_emu_event * CYCLE_UNIT / midi_emu_freq, audio_state_midi_emu_block, NULL);
+	if (midi_emu_streamid)
+		midi_emu_start_thread();
+	if (!midi_emu_tid) {
+		if (midi_emu_streamid)
+			audio_enable_stream(false, midi_emu_streamid, 0, NULL, NULL);
+		midi_emu_streamid = audio_enable_stream(true, -1, 2, audio_state_midi_emu, NULL);
+	}
 
 	return 1;
 }
@@ -1544,6 +1544,105 @@ static void invalidate_cpu_data_caches(void)
 	}
 }
 
+/* Predecoded instruction cache of the non-prefetch 68020+ loop
+ * (amiberry.conf cpu_predecode). Code is cached in 4K pages of the
+ * address space, with the opcode and its handler at each even offset, so
+ * running a cached instruction skips the opcode fetch and the lookup in
+ * the 512K cpufunctbl. Handlers still fetch their own extension words
+ * from memory, so only the opcode word can go stale.
+ *
+ * CPU writes clear the entries of the words they touch. The whole cache
+ * is dropped when the instruction cache is flushed (CACR, CINV, CPUSH) and
+ * when memory is remapped. DMA and host writes are not seen, just like by
+ * the instruction cache of a real 68020+, so the predecoded entries are
+ * only used while the emulated instruction cache is enabled.
+ */
+#define PREDECODE_PAGE_BITS 12
+#define PREDECODE_PAGE_MASK ((1 << PREDECODE_PAGE_BITS) - 1)
+#define PREDECODE_SLOTS 32
+#define PREDECODE_NOPAGE 0xffffffff
+
+struct predecode_entry {
+	cpuop_func *func;
+	uae_u16 opcode;
+};
+struct predecode_page {
+	uae_u32 page;
+	struct predecode_entry e[1 << (PREDECODE_PAGE_BITS - 1)];
+};
+static struct predecode_page *predecode_cache;
+static bool predecode_active;
+/* one byte per page of the 32-bit address space, set while it is cached */
+uae_u8 *cpu_predecode_pages;
+
+void cpu_predecode_flush(void)
+{
+	if (!predecode_cache)
+		return;
+	for (int i = 0; i < PREDECODE_SLOTS; i++) {
+		struct predecode_page *p = &predecode_cache[i];
+		if (p->page != PREDECODE_NOPAGE) {
+			cpu_predecode_pages[p->page] = 0;
+			p->page = PREDECODE_NOPAGE;
+		}
+	}
+}
+
+void cpu_predecode_written(uaecptr addr, int size)
+{
+	uaecptr end = addr + size - 1;
+	for (addr &= ~1; ; addr += 2) {
+		uae_u32 page = (addr & regs.address_space_mask) >> PREDECODE_PAGE_BITS;
+		if (cpu_predecode_pages[page]) {
+			struct predecode_page *p = &predecode_cache[page & (PREDECODE_SLOTS - 1)];
+			if (p->page == page)
+				p->e[(addr & PREDECODE_PAGE_MASK) >> 1].func = NULL;
+		}
+		if (((addr ^ end) & ~1) == 0)
+			break;
+	}
+}
+
+static void predecode_set_state(void)
+{
+	if (currprefs.cpu_model >= 68040)
+		predecode_active = predecode_cache && (regs.cacr & 0x8000);
+	else
+		predecode_active = predecode_cache && (regs.cacr & 0x01);
+}
+
+static void predecode_init(void)
+{
+	if (amiberry_options.cpu_predecode && !predecode_cache) {
+		predecode_cache = xmalloc(struct predecode_page, PREDECODE_SLOTS);
+		cpu_predecode_pages = xcalloc(uae_u8, 1 << (32 - PREDECODE_PAGE_BITS));
+		for (int i = 0; i < PREDECODE_SLOTS; i++)
+			predecode_cache[i].page = PREDECODE_NOPAGE;
+	} else if (!amiberry_options.cpu_predecode && predecode_cache) {
+		xfree(cpu_predecode_pages);
+		cpu_predecode_pages = NULL;
+		xfree(predecode_cache);
+		predecode_cache = NULL;
+	}
+	// cpufunctbl may have been rebuilt
+	cpu_predecode_flush();
+	predecode_set_state();
+}
+
+STATIC_INLINE struct predecode_entry *predecode_get(uaecptr pc)
+{
+	uae_u32 page = (pc & regs.address_space_mask) >> PREDECODE_PAGE_BITS;
+	struct predecode_page *p = &predecode_cache[page & (PREDECODE_SLOTS - 1)];
+	if (p->page != page) {
+		if (p->page != PREDECODE_NOPAGE)
+			cpu_predecode_pages[p->page] = 0;
+		memset(p->e, 0, sizeof p->e);
+		p->page = page;
+		cpu_predecode_pages[page] = 1;
+	}
+	return &p->e[(pc & PREDECODE_PAGE_MASK) >> 1];
+}
+
 #ifdef DEBUGGER
 static void flush_cpu_cache_debug(uaecptr addr, int size)
 {
@@ -1560,6 +1659,7 @@ void flush_cpu_caches(bool force)
 		if ((regs.cacr & 0x08) || force) { // clear instr cache
 			for (int i = 0; i < CACHELINES020; i++)
 				caches020[i].valid = 0;
+			cpu_predecode_flush();
 			regs.cacr &= ~0x08;
 #ifdef DEBUGGER
 			flush_cpu_cache_debug(0, -1);
@@ -1567,6 +1667,7 @@ void flush_cpu_caches(bool force)
 		}
 		if (regs.cacr & 0x04) { // clear entry in instr cache
 			caches020[(regs.caar >> 2) & (CACHELINES020 - 1)].valid = 0;
+			cpu_predecode_flush();
 			regs.cacr &= ~0x04;
 #ifdef DEBUGGER
 			flush_cpu_cache_debug(regs.caar, CACHELINES020);
@@ -1582,6 +1683,7 @@ void flush_cpu_caches(bool force)
 					icaches030[i].valid[3] = 0;
 				}
 			}
+			cpu_predecode_flush();
 			regs.cacr &= ~0x08;
 #ifdef DEBUGGER
 			flush_cpu_cache_debug(0, -1);
@@ -1589,6 +1691,7 @@ void flush_cpu_caches(bool force)
 		}
 		if (regs.cacr & 0x04) { // clear entry in instr cache
 			icaches030[(regs.caar >> 4) & (CACHELINES030 - 1)].valid[(regs.caar >> 2) & 3] = 0;
+			cpu_predecode_flush();
 			regs.cacr &= ~0x04;
 #ifdef DEBUGGER
 			flush_cpu_cache_debug(regs.caar, CACHELINES030);
@@ -1610,6 +1713,8 @@ void flush_cpu_caches(bool force)
 			regs.cacr &= ~0x400;
 		}
 	} else if (currprefs.cpu_model >= 68040) {
+		if (force)
+			cpu_predecode_flush();
 		if (doflush && force) {
 			mmu_flush_cache();
 			icachelinecnt = 0;
@@ -1688,6 +1793,7 @@ static void flush_cpu_caches_040_2(int cache, int scope, uaecptr addr, bool push
 	}
 	if (cache & 2) {
 		regs.prefetch020addr = 0xffffffff;
+		cpu_predecode_flush();
 	}
 	for (int k = 0; k < 2; k++) {
 		if (cache & (1 << k)) {
@@ -1819,6 +1925,7 @@ void set_cpu_caches (bool flush)
 	}
 #endif
 	flush_cpu_caches(flush);
+	predecode_set_state();
 }
 
 STATIC_INLINE void count_instr (uae_u32 opcode)
@@ -6446,6 +6553,16 @@ static int cpu_thread_run_2(void *v)
 }
 #endif
 
+/* Opcode fetch of the non-prefetch loops. When the PC points directly to
+ * host memory and no tracer is hooked in, read the word inline instead of
+ * calling through x_get_iword. Re-checked whenever the loop may have
+ * changed the fetch functions (specialties, exceptions).
+ */
+STATIC_INLINE bool pc_fetch_direct(void)
+{
+	return x_get_iword == get_diword;
+}
+
 /* Same thing, but don't use prefetch to get opcode.  */
 static void m68k_run_2_000(void)
 {
@@ -6454,11 +6571,12 @@ static void m68k_run_2_000(void)
 
 	while (!exit) {
 		check_debugger();
+		bool direct = pc_fetch_direct();
 		TRY(prb) {
 			while (!exit) {
 				r->instruction_pc = m68k_getpc ();
 
-				r->opcode = x_get_iword(0);
+				r->opcode = direct ? get_diword(0) : x_get_iword(0);
 				count_instr (r->opcode);
 #ifdef DEBUGGER
 				if (debug_opcode_watch) {
@@ -6473,6 +6591,7 @@ static void m68k_run_2_000(void)
 				if (r->spcflags) {
 					if (do_specialties (cpu_cycles))
 						exit = true;
+					direct = pc_fetch_direct();
 				}
 			}
 		} CATCH(prb) {
@@ -6497,13 +6616,28 @@ static void m68k_run_2_020(void)
 	struct regstruct *r = &regs;
 	bool exit = false;
 
+	predecode_init();
+
 	while (!exit) {
 		check_debugger();
+		bool direct = pc_fetch_direct();
 		TRY(prb) {
 			while (!exit) {
+				cpuop_func *func;
 				r->instruction_pc = m68k_getpc();
 
-				r->opcode = x_get_iword(0);
+				if (direct && predecode_active) {
+					struct predecode_entry *e = predecode_get(r->instruction_pc);
+					if (!e->func) {
+						e->opcode = get_diword(0);
+						e->func = cpufunctbl[e->opcode];
+					}
+					r->opcode = e->opcode;
+					func = e->func;
+				} else {
+					r->opcode = direct ? get_diword(0) : x_get_iword(0);
+					func = cpufunctbl[r->opcode];
+				}
 				count_instr(r->opcode);
 
 #ifdef DEBUGGER
@@ -6512,13 +6646,14 @@ static void m68k_run_2_020(void)
 				}
 #endif
 
-				cpu_cycles = (*cpufunctbl[r->opcode])(r->opcode) >> 16;
+				cpu_cycles = (*func)(r->opcode) >> 16;
 				cpu_cycles = adjust_cycles(cpu_cycles);
 				do_cycles(cpu_cycles);
 
 				if (r->spcflags) {
 					if (do_specialties(cpu_cycles))
 						exit = true;
+					direct = pc_fetch_direct();
 				}
 			}
 		} CATCH(prb) {
@@ -6813,6 +6948,8 @@ void m68k_go (int may_quit)
 #if 0
 		}
 #endif
+		// the main thread runs the emulation unless cpu_thread is enabled
+		uae_thread_set_role(currprefs.cpu_thread ? UAE_THREAD_ROLE_MAIN : UAE_THREAD_ROLE_EMU);
 		run_func();
 
 		if (quit_program < 0) {
@@ -3583,6 +3583,43 @@ void save_amiberry_settings(void)
 	// Default controller button for toggling the Virtual Keyboard
 	write_string_option("default_vkbd_toggle", amiberry_options.default_vkbd_toggle);
 
+	// CPU cores for the emulation, drawing, audio and I/O helper threads (e.g. "2-3", empty = any)
+	write_string_option("thread_affinity_emulation", amiberry_options.thread_affinity_emulation);
+	write_string_option("thread_affinity_drawing", amiberry_options.thread_affinity_drawing);
+	write_string_option("thread_affinity_audio", amiberry_options.thread_affinity_audio);
+	write_string_option("thread_affinity_io", amiberry_options.thread_affinity_io);
+
+	// Real-time scheduling for emulation, drawing and audio threads: none, fifo or rr
+	write_string_option("thread_rt_policy", amiberry_options.thread_rt_policy);
+	write_int_option("thread_rt_priority", amiberry_options.thread_rt_priority);
+
+	// Nice level for I/O helper threads (0 = unchanged)
+	write_int_option("thread_io_nice", amiberry_options.thread_io_nice);
+
+	// Thread and queue telemetry, optional CSV file and status line summary
+	write_bool_option("thread_telemetry", amiberry_options.thread_telemetry);
+	write_bool_option("thread_telemetry_overlay", amiberry_options.thread_telemetry_overlay);
+	write_string_option("thread_telemetry_file", amiberry_options.thread_telemetry_file);
+
+	// Copy-on-write hardfile overlays: delta directory and keep, discard or commit on close
+	write_string_option("hardfile_overlay_dir", amiberry_options.hardfile_overlay_dir);
+	write_string_option("hardfile_overlay_close", amiberry_options.hardfile_overlay_close);
+
+	// Read-ahead and write-behind buffering for files on directory mounted drives
+	write_bool_option("filesys_buffering", amiberry_options.filesys_buffering);
+
+	// Worker threads per directory mounted drive for reads, writes and seeks of different files (0 = off)
+	write_int_option("filesys_workers", amiberry_options.filesys_workers);
+
+	// Warp mode: frames drawn and shown per second of real time, audio mixing skipped (0 = off)
+	write_int_option("warp_present_rate", amiberry_options.warp_present_rate);
+
+	// Predecoded instruction cache for the 68020+ interpreter (used while the emulated instruction cache is on)
+	write_bool_option("cpu_predecode", amiberry_options.cpu_predecode);
+
+	// Serial port and TCP serial I/O from a separate thread instead of the emulation thread
+	write_bool_option("serial_io_thread", amiberry_options.serial_io_thread);
+
 	// GUI Theme: Font name
 	write_string_option("gui_theme_font_name", amiberry_options.gui_theme_font_name);
 
@@ -3833,6 +3870,23 @@ static int parse_amiberry_settings_line(const char *path, char *linea)
 		ret |= cfgfile_string(option, value, "default_vkbd_style", amiberry_options.default_vkbd_style, sizeof amiberry_options.default_vkbd_style);
 		ret |= cfgfile_intval(option, value, "default_vkbd_transparency", &amiberry_options.default_vkbd_transparency, 1);
 		ret |= cfgfile_string(option, value, "default_vkbd_toggle", amiberry_options.default_vkbd_toggle, sizeof amiberry_options.default_vkbd_toggle);
+		ret |= cfgfile_string(option, value, "thread_affinity_emulation", amiberry_options.thread_affinity_emulation, sizeof amiberry_options.thread_affinity_emulation);
+		ret |= cfgfile_string(option, value, "thread_affinity_drawing", amiberry_options.thread_affinity_drawing, sizeof amiberry_options.thread_affinity_drawing);
+		ret |= cfgfile_string(option, value, "thread_affinity_audio", amiberry_options.thread_affinity_audio, sizeof amiberry_options.thread_affinity_audio);
+		ret |= cfgfile_string(option, value, "thread_affinity_io", amiberry_options.thread_affinity_io, sizeof amiberry_options.thread_affinity_io);
+		ret |= cfgfile_string(option, value, "thread_rt_policy", amiberry_options.thread_rt_policy, sizeof amiberry_options.thread_rt_policy);
+		ret |= cfgfile_intval(option, value, "thread_rt_priority", &amiberry_options.thread_rt_priority, 1);
+		ret |= cfgfile_intval(option, value, "thread_io_nice", &amiberry_options.thread_io_nice, 1);
+		ret |= cfgfile_yesno(option, value, "thread_telemetry", &amiberry_options.thread_telemetry);
+		ret |= cfgfile_yesno(option, value, "thread_telemetry_overlay", &amiberry_options.thread_telemetry_overlay);
+		ret |= cfgfile_string(option, value, "thread_telemetry_file", amiberry_options.thread_telemetry_file, sizeof amiberry_options.thread_telemetry_file);
+		ret |= cfgfile_string(option, value, "hardfile_overlay_dir", amiberry_options.hardfile_overlay_dir, sizeof amiberry_options.hardfile_overlay_dir);
+		ret |= cfgfile_string(option, value, "hardfile_overlay_close", amiberry_options.hardfile_overlay_close, sizeof amiberry_options.hardfile_overlay_close);
+		ret |= cfgfile_yesno(option, value, "filesys_buffering", &amiberry_options.filesys_buffering);
+		ret |= cfgfile_intval(option, value, "filesys_workers", &amiberry_options.filesys_workers, 1);
+		ret |= cfgfile_intval(option, value, "warp_present_rate", &amiberry_options.warp_present_rate, 1);
+		ret |= cfgfile_yesno(option, value, "cpu_predecode", &amiberry_options.cpu_predecode);
+		ret |= cfgfile_yesno(option, value, "serial_io_thread", &amiberry_options.serial_io_thread);
 		ret |= cfgfile_string(option, value, "gui_theme_font_name", amiberry_options.gui_theme_font_name, sizeof amiberry_options.gui_theme_font_name);
 		ret |= cfgfile_intval(option, value, "gui_theme_font_size", &amiberry_options.gui_theme_font_size, 1);
 		ret |= cfgfile_string(option, value, "gui_theme_font_color", amiberry_options.gui_theme_font_color, sizeof amiberry_options.gui_theme_font_color);
@@ -4590,6 +4644,9 @@ int main(int argc, char* argv[])
 	enumserialports();
 #endif
 	enummidiports();
+	// process defaults until m68k_go() knows whether the main thread runs the CPU
+	uae_thread_telemetry_init();
+	uae_thread_set_role(UAE_THREAD_ROLE_MAIN);
 	real_main(argc, argv);
 
 #ifdef USE_GPIOD
@@ -522,6 +522,36 @@ unsigned int my_write(struct my_openfile_s* mos, void* b, unsigned int size)
 	return static_cast<unsigned int>(bytes_written);
 }
 
+int my_pread(struct my_openfile_s* mos, void* b, unsigned int size, uae_u64 offset)
+{
+	if (mos == nullptr || b == nullptr) {
+		write_log("my_pread: null pointer provided\n");
+		return -1;
+	}
+
+	const auto bytes_read = pread(mos->fd, b, size, static_cast<off_t>(offset));
+	if (bytes_read == -1) {
+		write_log("my_pread: pread failed with error %s\n", strerror(errno));
+		return -1;
+	}
+	return static_cast<int>(bytes_read);
+}
+
+int my_pwrite(struct my_openfile_s* mos, void* b, unsigned int size, uae_u64 offset)
+{
+	if (mos == nullptr || b == nullptr) {
+		write_log("my_pwrite: null pointer provided\n");
+		return -1;
+	}
+
+	const auto bytes_written = pwrite(mos->fd, b, size, static_cast<off_t>(offset));
+	if (bytes_written == -1) {
+		write_log("my_pwrite: pwrite failed with error %s\n", strerror(errno));
+		return -1;
+	}
+	return static_cast<int>(bytes_written);
+}
+
 int my_mkdir(const TCHAR* path)
 {
 	if (path == nullptr) {
@@ -5,13 +5,21 @@
 #include "filesys.h"
 #include "zfile.h"
 #include "uae.h"
+#include "crc32.h"
 
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+
+struct hdf_overlay;
 
 struct hardfilehandle
 {
 	int zfile;
 	struct zfile *zf;
 	FILE *h;
+	struct hdf_overlay *ovl;
 };
 
 struct uae_driveinfo {
@@ -168,6 +176,392 @@ static int isharddrive(const TCHAR* name)
 
 static const TCHAR *hdz[] = { _T("hdz"), _T("zip"), _T("7z"), nullptr };
 
+/* Copy-on-write overlay hardfiles.
+ *
+ * The base image is opened read-only and can be shared by any number of
+ * instances, every write goes to a per-instance delta file instead.
+ * Delta file layout, all values big endian:
+ *
+ *   0    "UAEHDOVL", version, block size, base size (64-bit), block count
+ *   64   base image path, NUL terminated
+ *   512  block map, one 32-bit entry per base block: 0 = block comes from
+ *        the base image, n = block is stored in data slot n
+ *   ...  data slots (block size each, rounded up to 512 byte map end),
+ *        appended in the order blocks were first written
+ *
+ * A delta file can be mounted directly as a hardfile, or created on demand
+ * for every writable hardfile when amiberry.conf hardfile_overlay_dir is set.
+ * Automatic deltas are named <config>-<image name>-<crc32 of image path>.ovl,
+ * so every configuration gets its own and equally named images in different
+ * directories don't collide. The delta is flock()ed while open and must
+ * name the same base image it is opened for. A delta that can't be opened
+ * for writing is used read-only.
+ */
+extern char last_loaded_config[MAX_DPATH];
+
+#define OVL_MAGIC "UAEHDOVL"
+#define OVL_VERSION 1
+#define OVL_BLOCKSIZE 65536
+#define OVL_HEADERSIZE 512
+#define OVL_PATHOFFSET 64
+
+struct hdf_overlay
+{
+	FILE *f;
+	uae_u32 blocksize;
+	uae_u32 blocks;
+	uae_u64 basesize;
+	uae_u64 dataoffset;
+	uae_u32 used;
+	uae_u32 *map;
+	uae_u8 *buf;
+	bool readonly;
+	TCHAR path[MAX_DPATH];
+	TCHAR basepath[MAX_DPATH];
+};
+
+static uae_u32 ovl_gl(const uae_u8 *p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | (p[3] << 0);
+}
+
+static void ovl_pl(uae_u8 *p, uae_u32 v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v >> 0;
+}
+
+static uae_u64 ovl_slot(struct hdf_overlay *ovl, uae_u32 slot)
+{
+	return ovl->dataoffset + (uae_u64)(slot - 1) * ovl->blocksize;
+}
+
+/* returns true and the base image path if 'name' is an overlay delta file */
+static bool overlay_probe(const TCHAR *name, TCHAR *basepath)
+{
+	uae_u8 hdr[OVL_HEADERSIZE];
+	bool ret = false;
+
+	FILE *f = uae_tfopen(name, "rb");
+	if (!f)
+		return false;
+	if (fread(hdr, 1, sizeof hdr, f) == sizeof hdr && !memcmp(hdr, OVL_MAGIC, 8)) {
+		hdr[sizeof hdr - 1] = 0;
+		_tcsncpy(basepath, (const char*)hdr + OVL_PATHOFFSET, MAX_DPATH - 1);
+		basepath[MAX_DPATH - 1] = 0;
+		ret = true;
+	}
+	fclose(f);
+	return ret;
+}
+
+static void overlay_close(struct hdf_overlay *ovl)
+{
+	if (!ovl)
+		return;
+	if (ovl->f)
+		fclose(ovl->f);
+	xfree(ovl->map);
+	xfree(ovl->buf);
+	xfree(ovl);
+}
+
+/* automatic delta file name for base image 'name' */
+static void overlay_name(TCHAR *out, const TCHAR *name)
+{
+	TCHAR config[MAX_DPATH];
+	const TCHAR *base = _tcsrchr(name, '/');
+
+	_tcscpy(config, last_loaded_config[0] ? last_loaded_config : _T("default"));
+	TCHAR *ext = _tcsrchr(config, '.');
+	if (ext)
+		*ext = 0;
+	_stprintf(out, _T("%s/%s-%s-%08x.ovl"), amiberry_options.hardfile_overlay_dir, config,
+		base ? base + 1 : name, get_crc32((void*)name, (int)_tcslen(name)));
+}
+
+/* Open existing delta file or create a new empty one for 'basepath'.
+ * *locked is set if another instance has the delta open. */
+static struct hdf_overlay *overlay_open(const TCHAR *path, const TCHAR *basepath, uae_u64 basesize, bool *locked)
+{
+	struct hdf_overlay *ovl = xcalloc(struct hdf_overlay, 1);
+	uae_u8 hdr[OVL_HEADERSIZE];
+	uae_u32 mapsize;
+	struct stat st;
+
+	*locked = false;
+	_tcsncpy(ovl->path, path, MAX_DPATH - 1);
+	_tcsncpy(ovl->basepath, basepath, MAX_DPATH - 1);
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		fd = open(path, O_RDONLY);
+		if (fd < 0) {
+			write_log(_T("HDF overlay '%s': can't open or create, error %d\n"), path, errno);
+			goto fail;
+		}
+		ovl->readonly = true;
+	}
+	if (flock(fd, (ovl->readonly ? LOCK_SH : LOCK_EX) | LOCK_NB) != 0) {
+		write_log(_T("HDF overlay '%s': in use by another instance\n"), path);
+		*locked = true;
+		close(fd);
+		goto fail;
+	}
+	ovl->f = fdopen(fd, ovl->readonly ? "rb" : "r+b");
+	if (!ovl->f) {
+		close(fd);
+		goto fail;
+	}
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		uae_u8 *p;
+		if (fread(hdr, 1, sizeof hdr, ovl->f) != sizeof hdr || memcmp(hdr, OVL_MAGIC, 8) || ovl_gl(hdr + 8) != OVL_VERSION) {
+			write_log(_T("HDF overlay '%s': not an overlay file\n"), path);
+			goto fail;
+		}
+		hdr[sizeof hdr - 1] = 0;
+		if (_tcscmp((const char*)hdr + OVL_PATHOFFSET, basepath)) {
+			write_log(_T("HDF overlay '%s': belongs to '%s', not '%s'\n"), path, (const char*)hdr + OVL_PATHOFFSET, basepath);
+			goto fail;
+		}
+		ovl->blocksize = ovl_gl(hdr + 12);
+		ovl->basesize = ((uae_u64)ovl_gl(hdr + 16) << 32) | ovl_gl(hdr + 20);
+		ovl->blocks = ovl_gl(hdr + 24);
+		if (ovl->basesize != basesize || ovl->blocksize < 512 || (ovl->blocksize & 511) ||
+			ovl->blocks != (basesize + ovl->blocksize - 1) / ovl->blocksize) {
+			write_log(_T("HDF overlay '%s': base image size changed (%llu, expected %llu)\n"), path, basesize, ovl->basesize);
+			goto fail;
+		}
+		mapsize = (ovl->blocks * 4 + 511) & ~511;
+		p = xmalloc(uae_u8, mapsize);
+		if (fread(p, 1, mapsize, ovl->f) != mapsize) {
+			write_log(_T("HDF overlay '%s': block map read error\n"), path);
+			xfree(p);
+			goto fail;
+		}
+		ovl->map = xcalloc(uae_u32, ovl->blocks);
+		for (uae_u32 i = 0; i < ovl->blocks; i++) {
+			ovl->map[i] = ovl_gl(p + i * 4);
+			if (ovl->map[i] > ovl->used)
+				ovl->used = ovl->map[i];
+		}
+		xfree(p);
+	} else {
+		if (ovl->readonly) {
+			write_log(_T("HDF overlay '%s': empty and not writable\n"), path);
+			goto fail;
+		}
+		ovl->blocksize = OVL_BLOCKSIZE;
+		ovl->basesize = basesize;
+		ovl->blocks = (uae_u32)((basesize + ovl->blocksize - 1) / ovl->blocksize);
+		mapsize = (ovl->blocks * 4 + 511) & ~511;
+		memset(hdr, 0, sizeof hdr);
+		memcpy(hdr, OVL_MAGIC, 8);
+		ovl_pl(hdr + 8, OVL_VERSION);
+		ovl_pl(hdr + 12, ovl->blocksize);
+		ovl_pl(hdr + 16, (uae_u32)(basesize >> 32));
+		ovl_pl(hdr + 20, (uae_u32)basesize);
+		ovl_pl(hdr + 24, ovl->blocks);
+		_tcsncpy((char*)hdr + OVL_PATHOFFSET, basepath, sizeof hdr - OVL_PATHOFFSET - 1);
+		ovl->map = xcalloc(uae_u32, ovl->blocks);
+		uae_u8 *p = xcalloc(uae_u8, mapsize);
+		if (fwrite(hdr, 1, sizeof hdr, ovl->f) != sizeof hdr || fwrite(p, 1, mapsize, ovl->f) != mapsize) {
+			write_log(_T("HDF overlay '%s': header write error\n"), path);
+			xfree(p);
+			goto fail;
+		}
+		xfree(p);
+		fflush(ovl->f);
+	}
+	ovl->dataoffset = OVL_HEADERSIZE + mapsize;
+	ovl->buf = xmalloc(uae_u8, ovl->blocksize);
+	write_log(_T("HDF overlay '%s' opened%s, base '%s', %u of %u blocks in delta\n"),
+		path, ovl->readonly ? _T(" read-only") : _T(""), basepath, ovl->used, ovl->blocks);
+	return ovl;
+fail:
+	overlay_close(ovl);
+	return nullptr;
+}
+
+/* read from absolute base image position 'pos', each block resolved from delta or base */
+static int overlay_read(struct hardfilehandle *hh, uae_u8 *buf, uae_u64 pos, int len)
+{
+	struct hdf_overlay *ovl = hh->ovl;
+	int got = 0;
+
+	while (len > 0) {
+		uae_u32 blk = (uae_u32)(pos / ovl->blocksize);
+		uae_u32 off = (uae_u32)(pos % ovl->blocksize);
+		uae_u32 slot = blk < ovl->blocks ? ovl->map[blk] : 0;
+		int n = ovl->blocksize - off;
+		FILE *f = hh->h;
+		uae_u64 fpos = pos;
+
+		// extend over following blocks that are contiguous in the same file
+		for (uae_u32 b = blk + 1; n < len; b++) {
+			uae_u32 next = b < ovl->blocks ? ovl->map[b] : 0;
+			if (slot ? next != slot + (b - blk) : next != 0)
+				break;
+			n += ovl->blocksize;
+		}
+		if (n > len)
+			n = len;
+		if (slot) {
+			f = ovl->f;
+			fpos = ovl_slot(ovl, slot) + off;
+		}
+		if (_fseeki64(f, fpos, SEEK_SET) != 0)
+			break;
+		int r = fread(buf + got, 1, n, f);
+		got += r;
+		if (r != n)
+			break;
+		pos += n;
+		len -= n;
+	}
+	return got;
+}
+
+/* first write to a block: append it to the delta and point the map at it */
+static bool overlay_alloc(struct hdf_overlay *ovl, uae_u32 blk, const uae_u8 *data)
+{
+	uae_u8 entry[4];
+	uae_u32 slot = ovl->used + 1;
+
+	if (_fseeki64(ovl->f, ovl_slot(ovl, slot), SEEK_SET) != 0 || fwrite(data, 1, ovl->blocksize, ovl->f) != ovl->blocksize)
+		return false;
+	// data first, map entry last: the data is flushed to the OS before the
+	// map points at it, so if the emulator dies in between the old block is
+	// still visible. Ordering on power loss is up to the host filesystem.
+	if (fflush(ovl->f) != 0)
+		return false;
+	ovl_pl(entry, slot);
+	if (_fseeki64(ovl->f, OVL_HEADERSIZE + blk * 4, SEEK_SET) != 0 || fwrite(entry, 1, 4, ovl->f) != 4)
+		return false;
+	ovl->map[blk] = slot;
+	ovl->used = slot;
+	return true;
+}
+
+static int overlay_write(struct hardfilehandle *hh, const uae_u8 *buf, uae_u64 pos, int len)
+{
+	struct hdf_overlay *ovl = hh->ovl;
+	int done = 0;
+
+	if (ovl->readonly)
+		return 0;
+
+	while (len > 0) {
+		uae_u32 blk = (uae_u32)(pos / ovl->blocksize);
+		uae_u32 off = (uae_u32)(pos % ovl->blocksize);
+		int n = ovl->blocksize - off;
+
+		if (n > len)
+			n = len;
+		if (blk >= ovl->blocks)
+			break;
+		if (!ovl->map[blk]) {
+			const uae_u8 *src = buf + done;
+			if (n != (int)ovl->blocksize) {
+				// partial block, merge with base image contents
+				// the last block may extend past the end of the base image
+				memset(ovl->buf, 0, ovl->blocksize);
+				if (_fseeki64(hh->h, (uae_u64)blk * ovl->blocksize, SEEK_SET) != 0 ||
+					(fread(ovl->buf, 1, ovl->blocksize, hh->h) != ovl->blocksize && ferror(hh->h))) {
+					write_log(_T("HDF overlay '%s': base image read error\n"), ovl->path);
+					clearerr(hh->h);
+					break;
+				}
+				memcpy(ovl->buf + off, buf + done, n);
+				src = ovl->buf;
+			}
+			if (!overlay_alloc(ovl, blk, src)) {
+				write_log(_T("HDF overlay '%s': write error\n"), ovl->path);
+				break;
+			}
+		} else {
+			if (_fseeki64(ovl->f, ovl_slot(ovl, ovl->map[blk]) + off, SEEK_SET) != 0 ||
+				fwrite(buf + done, 1, n, ovl->f) != (size_t)n) {
+				write_log(_T("HDF overlay '%s': write error\n"), ovl->path);
+				break;
+			}
+		}
+		done += n;
+		pos += n;
+		len -= n;
+	}
+	return done;
+}
+
+/* drop all changes, delta shrinks back to header and empty map */
+static int overlay_discard(struct hdf_overlay *ovl)
+{
+	uae_u32 mapsize = (uae_u32)(ovl->dataoffset - OVL_HEADERSIZE);
+	uae_u8 *p = xcalloc(uae_u8, mapsize);
+	int ok = _fseeki64(ovl->f, OVL_HEADERSIZE, SEEK_SET) == 0 && fwrite(p, 1, mapsize, ovl->f) == mapsize;
+	xfree(p);
+	fflush(ovl->f);
+	if (!ok || ftruncate(fileno(ovl->f), ovl->dataoffset) != 0) {
+		write_log(_T("HDF overlay '%s': discard failed, error %d\n"), ovl->path, errno);
+		return 0;
+	}
+	memset(ovl->map, 0, ovl->blocks * sizeof(uae_u32));
+	ovl->used = 0;
+	write_log(_T("HDF overlay '%s': changes discarded\n"), ovl->path);
+	return 1;
+}
+
+/* write all delta blocks back to the base image, then empty the delta */
+static int overlay_commit(struct hardfilehandle *hh)
+{
+	struct hdf_overlay *ovl = hh->ovl;
+	uae_u32 cnt = 0;
+
+	FILE *b = uae_tfopen(ovl->basepath, "r+b");
+	if (!b) {
+		write_log(_T("HDF overlay '%s': base '%s' is not writable, error %d\n"), ovl->path, ovl->basepath, errno);
+		return 0;
+	}
+	for (uae_u32 blk = 0; blk < ovl->blocks; blk++) {
+		if (!ovl->map[blk])
+			continue;
+		uae_u64 pos = (uae_u64)blk * ovl->blocksize;
+		uae_u32 n = ovl->blocksize;
+		if (pos + n > ovl->basesize)
+			n = (uae_u32)(ovl->basesize - pos);
+		if (_fseeki64(ovl->f, ovl_slot(ovl, ovl->map[blk]), SEEK_SET) != 0 || fread(ovl->buf, 1, n, ovl->f) != n ||
+			_fseeki64(b, pos, SEEK_SET) != 0 || fwrite(ovl->buf, 1, n, b) != n) {
+			write_log(_T("HDF overlay '%s': commit failed at block %u, delta kept\n"), ovl->path, blk);
+			fclose(b);
+			return 0;
+		}
+		cnt++;
+	}
+	if (fclose(b) != 0) {
+		write_log(_T("HDF overlay '%s': commit failed, error %d, delta kept\n"), ovl->path, errno);
+		return 0;
+	}
+	// base image changed under our read-only handle
+	fflush(hh->h);
+	write_log(_T("HDF overlay '%s': %u blocks committed to '%s'\n"), ovl->path, cnt, ovl->basepath);
+	return overlay_discard(ovl);
+}
+
+static int hdf_fread(struct hardfiledata *hfd, void *buffer, int len, uae_u64 pos)
+{
+	if (hfd->handle->ovl)
+		return overlay_read(hfd->handle, (uae_u8*)buffer, pos, len);
+	return fread(buffer, 1, len, hfd->handle->h);
+}
+
+static int hdf_fwrite(struct hardfiledata *hfd, const void *buffer, int len, uae_u64 pos)
+{
+	if (hfd->handle->ovl)
+		return overlay_write(hfd->handle, (const uae_u8*)buffer, pos, len);
+	return fwrite(buffer, 1, len, hfd->handle->h);
+}
+
 int hdf_open_target(struct hardfiledata *hfd, const TCHAR *pname)
 {
 	FILE *h = INVALID_HANDLE_VALUE;
@@ -175,6 +569,8 @@ int hdf_open_target(struct hardfiledata *hfd, const TCHAR *pname)
 	char* name = my_strdup(pname);
 	TCHAR* ext;
 	int zmode = 0;
+	TCHAR ovlname[MAX_DPATH];
+	TCHAR basepath[MAX_DPATH];
 	
 	hfd->flags = 0;
 	hfd->drive_empty = 0;
@@ -200,8 +596,20 @@ int hdf_open_target(struct hardfiledata *hfd, const TCHAR *pname)
 				zmode = 1;
 		}
 	}
-	h = uae_tfopen(name, hfd->ci.readonly ? "rb" : "r+b");
-	if (h == INVALID_HANDLE_VALUE && !hfd->ci.readonly) {
+	ovlname[0] = 0;
+	if (overlay_probe(name, basepath)) {
+		// mounted the delta file itself, base path comes from its header
+		_tcscpy(ovlname, name);
+		xfree(name);
+		name = my_strdup(basepath);
+	} else if (amiberry_options.hardfile_overlay_dir[0] && !hfd->ci.readonly && !zmode) {
+		overlay_name(ovlname, name);
+	}
+	if (ovlname[0])
+		h = uae_tfopen(name, "rb");
+	else
+		h = uae_tfopen(name, hfd->ci.readonly ? "rb" : "r+b");
+	if (h == INVALID_HANDLE_VALUE && !hfd->ci.readonly && !ovlname[0]) {
 		h = uae_tfopen(name, "rb");
 		if (h != INVALID_HANDLE_VALUE)
 			hfd->ci.readonly = true;
@@ -243,6 +651,19 @@ int hdf_open_target(struct hardfiledata *hfd, const TCHAR *pname)
 			zfile_fseek(hfd->handle->zf, 0, SEEK_SET);
 			hfd->handle_valid = HDF_HANDLE_ZFILE;
 		}
+		if (ovlname[0] && hfd->handle_valid == HDF_HANDLE_LINUX) {
+			bool locked;
+			hfd->handle->ovl = overlay_open(ovlname, name, hfd->physsize, &locked);
+			if (!hfd->handle->ovl) {
+				// automatic delta not possible here, use the base image read-only
+				if (locked || !_tcscmp(ovlname, pname))
+					goto end;
+				write_log(_T("HDF '%s': no overlay, mounted read-only\n"), name);
+				hfd->ci.readonly = true;
+			} else if (hfd->handle->ovl->readonly) {
+				hfd->ci.readonly = true;
+			}
+		}
 	}
 	else {
 		write_log("HDF '%s' failed to open. error = %d\n", name, errno);
@@ -263,6 +684,8 @@ static void freehandle(struct hardfilehandle* h)
 {
 	if (!h)
 		return;
+	overlay_close(h->ovl);
+	h->ovl = NULL;
 	if (!h->zfile && h->h != 0)
 		fclose(h->h);
 	if (h->zfile && h->zf)
@@ -274,6 +697,12 @@ static void freehandle(struct hardfilehandle* h)
 
 void hdf_close_target(struct hardfiledata* hfd) {
 	write_log("hdf_close_target\n");
+	if (hfd->handle && hfd->handle->ovl && !hfd->handle->ovl->readonly) {
+		if (!_tcsicmp(amiberry_options.hardfile_overlay_close, _T("discard")))
+			overlay_discard(hfd->handle->ovl);
+		else if (!_tcsicmp(amiberry_options.hardfile_overlay_close, _T("commit")))
+			overlay_commit(hfd->handle);
+	}
 	freehandle (hfd->handle);
 	xfree(hfd->handle);
 	xfree(hfd->emptyname);
@@ -415,7 +844,7 @@ static int hdf_read_2(struct hardfiledata *hfd, void *buffer, uae_u64 offset, in
 		return 0;
 	poscheck(hfd, CACHE_SIZE);
 	if (hfd->handle_valid == HDF_HANDLE_LINUX)
-		outlen = fread(hfd->cache, 1, CACHE_SIZE, hfd->handle->h);
+		outlen = hdf_fread(hfd, hfd->cache, CACHE_SIZE, hfd->cache_offset + hfd->offset);
 	else if (hfd->handle_valid == HDF_HANDLE_ZFILE)
 		outlen = zfile_fread(hfd->cache, 1, CACHE_SIZE, hfd->handle->zf);
 	hfd->cache_valid = 0;
@@ -454,7 +883,7 @@ int hdf_read_target(struct hardfiledata *hfd, void *buffer, uae_u64 offset, int
 				poscheck(hfd, len);
 			if (hfd->handle_valid == HDF_HANDLE_LINUX)
 			{
-				ret = fread(hfd->cache, 1, len, hfd->handle->h);
+				ret = hdf_fread(hfd, hfd->cache, len, offset + hfd->offset);
 				memcpy(buffer, hfd->cache, ret);
 			}
 			else if (hfd->handle_valid == HDF_HANDLE_ZFILE)
@@ -496,7 +925,7 @@ static int hdf_write_2(struct hardfiledata *hfd, void *buffer, uae_u64 offset, i
 	memcpy(hfd->cache, buffer, len);
 	if (hfd->handle_valid == HDF_HANDLE_LINUX)
 	{
-		outlen = fwrite(hfd->cache, 1, len, hfd->handle->h);
+		outlen = hdf_fwrite(hfd, hfd->cache, len, offset + hfd->offset);
 		const auto* const name = hfd->emptyname == nullptr ? _T("<unknown>") : hfd->emptyname;
 		if (offset == 0)
 		{
@@ -507,7 +936,7 @@ static int hdf_write_2(struct hardfiledata *hfd, void *buffer, uae_u64 offset, i
 				int cmplen = tmplen > len ? len : tmplen;
 				memset(tmp, 0xa1, tmplen);
 				hdf_seek(hfd, offset);
-				int outlen2 = fread(tmp, 1, tmplen, hfd->handle->h);
+				int outlen2 = hdf_fread(hfd, tmp, tmplen, offset + hfd->offset);
 				if (memcmp(hfd->cache, tmp, cmplen) != 0 || outlen != len)
 					gui_message(_T("\"%s\"\n\nblock zero write failed!"), name);
 				xfree(tmp);
@@ -545,6 +974,10 @@ int hdf_write_target(struct hardfiledata *hfd, void *buffer, uae_u64 offset, int
 
 int hdf_resize_target(struct hardfiledata* hfd, uae_u64 newsize)
 {
+	if (hfd->handle->ovl) {
+		write_log("hdf_resize_target: not supported on overlay hardfiles\n");
+		return 0;
+	}
 	if (newsize < hfd->physsize) {
 		write_log("hdf_resize_target: truncation not implemented\n");
 		return 0;
@@ -43,6 +43,10 @@
 #endif
 
 #include <libserialport.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "threaddep/thread.h"
 
 #define SERIALLOGGING 0
 #define SERIALDEBUG 0 /* 0, 1, 2 3 */
@@ -330,10 +334,294 @@ static int opentcp (const TCHAR *sername)
 	return 1;
 }
 
+/* Port and TCP traffic goes through a dedicated thread that sleeps in poll(),
+ * so the per-scanline readseravail()/readser()/writeser() calls only touch
+ * the ring buffers below instead of making a system call each time.
+ * amiberry.conf serial_io_thread=no keeps the direct calls. */
+#define SERIAL_IO_THREAD 1
+#define SERIAL_IO_RING 4096
+
+#if SERIAL_IO_THREAD
+
+/* rx is filled by the I/O thread and drained by the emulation, tx the other
+ * way round. Indices run freely and are masked on access. */
+struct serial_ring {
+	uae_u8 data[SERIAL_IO_RING];
+	uae_u32 rdp, wrp;
+};
+
+static struct serial_ring serio_rx, serio_tx;
+
+/* totals are logged when the thread stops */
+struct serial_io_stats {
+	uae_u64 rx_bytes;
+	uae_u64 tx_bytes;
+	uae_u64 syscalls;
+	uae_u64 overruns;
+};
+static struct serial_io_stats serio_stats;
+static bool serio_active;
+static volatile bool serio_quit;
+static volatile bool serio_failed;
+static bool serio_tx_overflow;
+static int serio_kicked;
+static int serio_wakefd[2] = { -1, -1 };
+static uae_thread_id serio_tid;
+
+STATIC_INLINE uae_u32 serio_ring_used(struct serial_ring *r)
+{
+	return __atomic_load_n(&r->wrp, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->rdp, __ATOMIC_ACQUIRE);
+}
+
+STATIC_INLINE void serio_count(uae_u64 *counter, int v)
+{
+	__atomic_add_fetch(counter, v, __ATOMIC_RELAXED);
+}
+
+/* Wake the I/O thread, at most one write to the wakeup pipe per sleep */
+static void serio_kick(void)
+{
+	if (!__atomic_exchange_n(&serio_kicked, 1, __ATOMIC_SEQ_CST)) {
+		uae_u8 b = 0;
+		if (write(serio_wakefd[1], &b, 1) < 0)
+			write_log(_T("SERIAL: wakeup failed\n"));
+	}
+}
+
+static bool serio_fill_rx(int fd)
+{
+	struct serial_ring *r = &serio_rx;
+	uae_u32 wrp = r->wrp;
+	uae_u32 space = SERIAL_IO_RING - (wrp - __atomic_load_n(&r->rdp, __ATOMIC_ACQUIRE));
+	uae_u32 off = wrp & (SERIAL_IO_RING - 1);
+	int len = space < SERIAL_IO_RING - off ? space : SERIAL_IO_RING - off;
+	int got;
+
+	if (len <= 0)
+		return true;
+	if (tcpserial)
+		got = uae_socket_read(serialconn, r->data + off, len);
+	else
+		got = sp_nonblocking_read(port, r->data + off, len);
+	serio_count(&serio_stats.syscalls, 1);
+	if (got <= 0)
+		return !tcpserial && got == 0;
+	serio_count(&serio_stats.rx_bytes, got);
+	__atomic_store_n(&r->wrp, wrp + got, __ATOMIC_RELEASE);
+	return true;
+}
+
+static bool serio_drain_tx(void)
+{
+	struct serial_ring *r = &serio_tx;
+	while (serio_ring_used(r)) {
+		uae_u32 rdp = r->rdp;
+		uae_u32 used = __atomic_load_n(&r->wrp, __ATOMIC_ACQUIRE) - rdp;
+		uae_u32 off = rdp & (SERIAL_IO_RING - 1);
+		int len = used < SERIAL_IO_RING - off ? used : SERIAL_IO_RING - off;
+		int put;
+		if (tcpserial) {
+			if (serialconn == UAE_SOCKET_INVALID)
+				put = len; // nobody connected, drop it like the unthreaded path does
+			else
+				put = uae_socket_write(serialconn, r->data + off, len);
+		} else {
+			put = sp_nonblocking_write(port, r->data + off, len);
+		}
+		serio_count(&serio_stats.syscalls, 1);
+		if (put < 0)
+			return false;
+		serio_count(&serio_stats.tx_bytes, put);
+		__atomic_store_n(&r->rdp, rdp + put, __ATOMIC_RELEASE);
+		if (put < len)
+			break; // would block, wait for POLLOUT
+	}
+	return true;
+}
+
+static int serial_io_thread(void *v)
+{
+	int portfd = -1;
+
+	if (!tcpserial)
+		sp_get_port_handle(port, &portfd);
+
+	while (!serio_quit) {
+		struct pollfd pfd[2];
+		bool listening = tcpserial && serialconn == UAE_SOCKET_INVALID;
+		bool rxfull = serio_ring_used(&serio_rx) >= SERIAL_IO_RING;
+		int timeout = -1;
+		int fd = tcpserial ? (listening ? serialsocket : serialconn) : portfd;
+
+		pfd[0].fd = serio_wakefd[0];
+		pfd[0].events = POLLIN;
+		pfd[1].fd = fd;
+		pfd[1].events = 0;
+		if (listening || !rxfull)
+			pfd[1].events |= POLLIN;
+		if (!listening && serio_ring_used(&serio_tx))
+			pfd[1].events |= POLLOUT;
+		if (rxfull) {
+			// emulation side does not kick us when it consumes, so check back shortly
+			timeout = 10;
+		}
+
+		int n = poll(pfd, fd >= 0 ? 2 : 1, timeout);
+		serio_count(&serio_stats.syscalls, 1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			write_log(_T("SERIAL: poll failed %d\n"), errno);
+			__atomic_store_n(&serio_failed, true, __ATOMIC_RELEASE);
+			break;
+		}
+		if (pfd[0].revents & POLLIN) {
+			uae_u8 buf[16];
+			while (read(serio_wakefd[0], buf, sizeof buf) > 0);
+			__atomic_store_n(&serio_kicked, 0, __ATOMIC_SEQ_CST);
+		}
+		if (listening) {
+			if (pfd[1].revents & POLLIN) {
+				serialconn = uae_socket_accept(serialsocket);
+				if (serialconn != UAE_SOCKET_INVALID)
+					write_log(_T("TCP: Serial connection accepted\n"));
+			}
+			// drop anything written while nobody was connected
+			serio_drain_tx();
+			continue;
+		}
+		bool ok = true;
+		if (pfd[1].revents & POLLIN)
+			ok = serio_fill_rx(fd);
+		else if (pfd[1].revents & (POLLHUP | POLLERR | POLLNVAL))
+			ok = false;
+		if (ok)
+			ok = serio_drain_tx();
+		if (!ok) {
+			if (tcpserial) {
+				tcp_disconnect();
+			} else {
+				write_log(_T("SERIAL: I/O error, stopping serial thread\n"));
+				__atomic_store_n(&serio_failed, true, __ATOMIC_RELEASE);
+				break;
+			}
+		}
+	}
+	return 0;
+}
+
+static void serial_io_start(void)
+{
+	if (serio_active)
+		return;
+	if (!tcpserial && !port)
+		return;
+	if (!amiberry_options.serial_io_thread)
+		return;
+	if (pipe(serio_wakefd) < 0) {
+		serio_wakefd[0] = serio_wakefd[1] = -1;
+		return;
+	}
+	fcntl(serio_wakefd[0], F_SETFL, O_NONBLOCK);
+	fcntl(serio_wakefd[1], F_SETFL, O_NONBLOCK);
+	serio_rx.rdp = serio_rx.wrp = 0;
+	serio_tx.rdp = serio_tx.wrp = 0;
+	serio_kicked = 0;
+	serio_quit = false;
+	serio_failed = false;
+	serio_tx_overflow = false;
+	memset(&serio_stats, 0, sizeof serio_stats);
+	if (!uae_start_thread(_T("serial"), serial_io_thread, NULL, &serio_tid)) {
+		write_log(_T("SERIAL: could not start I/O thread, using direct access\n"));
+		close(serio_wakefd[0]);
+		close(serio_wakefd[1]);
+		serio_wakefd[0] = serio_wakefd[1] = -1;
+		return;
+	}
+	serio_active = true;
+}
+
+static void serial_io_stop(void)
+{
+	if (!serio_active)
+		return;
+	serio_quit = true;
+	__atomic_store_n(&serio_kicked, 0, __ATOMIC_SEQ_CST);
+	serio_kick();
+	uae_wait_thread(&serio_tid);
+	close(serio_wakefd[0]);
+	close(serio_wakefd[1]);
+	serio_wakefd[0] = serio_wakefd[1] = -1;
+	serio_active = false;
+	write_log(_T("SERIAL: I/O thread stopped. RX %llu TX %llu bytes, %llu syscalls, %llu overruns\n"),
+		serio_stats.rx_bytes, serio_stats.tx_bytes, serio_stats.syscalls, serio_stats.overruns);
+}
+
+static int serial_io_read(int *buffer)
+{
+	struct serial_ring *r = &serio_rx;
+	uae_u32 rdp = r->rdp;
+	if (rdp == __atomic_load_n(&r->wrp, __ATOMIC_ACQUIRE))
+		return 0;
+	*buffer = r->data[rdp & (SERIAL_IO_RING - 1)];
+	__atomic_store_n(&r->rdp, rdp + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+static void serial_io_write(int c)
+{
+	struct serial_ring *r = &serio_tx;
+	uae_u32 wrp = r->wrp;
+	if (wrp - __atomic_load_n(&r->rdp, __ATOMIC_ACQUIRE) >= SERIAL_IO_RING) {
+		serio_count(&serio_stats.overruns, 1);
+		// once per overflow, the total is in the stop statistics
+		if (!serio_tx_overflow)
+			write_log(_T("serial output buffer overflow, data will be lost\n"));
+		serio_tx_overflow = true;
+		return;
+	}
+	serio_tx_overflow = false;
+	r->data[wrp & (SERIAL_IO_RING - 1)] = (uae_u8)c;
+	__atomic_store_n(&r->wrp, wrp + 1, __ATOMIC_SEQ_CST);
+	serio_kick();
+}
+
+/* I/O thread usable, a thread that died on an error is joined here and
+ * the callers fall back to direct access */
+static bool serio_running(void)
+{
+	if (serio_active && __atomic_load_n(&serio_failed, __ATOMIC_ACQUIRE)) {
+		write_log(_T("SERIAL: I/O thread failed, using direct access\n"));
+		serial_io_stop();
+	}
+	return serio_active;
+}
+
+static void serial_io_flush(void)
+{
+	__atomic_store_n(&serio_rx.rdp, __atomic_load_n(&serio_rx.wrp, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+#else
+
+#define serio_active false
+#define serio_running() false
+#define serio_ring_used(r) 0
+static void serial_io_start(void) { }
+static void serial_io_stop(void) { }
+static int serial_io_read(int *buffer) { return 0; }
+static void serial_io_write(int c) { }
+static void serial_io_flush(void) { }
+
+#endif
+
 int openser (const TCHAR *sername)
 {
 	if (_tcsnicmp(sername, _T("tcp:"), 4) == 0) {
-		return opentcp(sername);
+		int result = opentcp(sername);
+		if (result)
+			serial_io_start();
+		return result;
 	}
 
 	/* Call sp_get_port_by_name() to find the port. The port
@@ -353,11 +641,14 @@ int openser (const TCHAR *sername)
 	{
 		check(sp_set_flowcontrol(port, SP_FLOWCONTROL_NONE));
 	}
+	if (result == SP_OK)
+		serial_io_start();
 	return result;
 }
 
 void closeser ()
 {
+	serial_io_stop();
 	if (tcpserial) {
 		closetcp();
 		tcpserial = FALSE;
@@ -479,6 +770,8 @@ static TCHAR dochar(int v)
 int readser(int* buffer)
 {
 	if (tcpserial) {
+		if (serio_running())
+			return serial_io_read(buffer);
 		if (tcp_is_connected()) {
 			char buf[1];
 			buf[0] = 0;
@@ -502,6 +795,8 @@ int readser(int* buffer)
 	} else {
 		if (!currprefs.use_serial)
 			return 0;
+		if (serio_running())
+			return serial_io_read(buffer);
 		if (dataininput > dataininputcnt) {
 			*buffer = inputbuffer[dataininputcnt++];
 			return 1;
@@ -528,6 +823,8 @@ int readser(int* buffer)
 
 void flushser(void)
 {
+	if (serio_running())
+		serial_io_flush();
 	if (serdev) {
 		check(sp_flush(port, SP_BUF_BOTH));
 	}
@@ -538,6 +835,8 @@ int readseravail(bool* breakcond)
 	if (breakcond)
 		*breakcond = false;
 	if (tcpserial) {
+		if (serio_running())
+			return serio_ring_used(&serio_rx) > 0;
 		if (tcp_is_connected()) {
 			int err = uae_socket_select_read(serialconn);
 			if (err == UAE_SELECT_ERROR) {
@@ -563,6 +862,8 @@ int readseravail(bool* breakcond)
 				*breakcond = true;
 				breakpending = false;
 			}
+			if (serio_running())
+				return serio_ring_used(&serio_rx);
 			const int bytes = check(sp_input_waiting(port));
 			if (bytes > 0)
 				return bytes;
@@ -782,6 +1083,10 @@ void writeser_flush(void)
 void writeser(int c)
 {
 	if (tcpserial) {
+		if (serio_running()) {
+			serial_io_write(c);
+			return;
+		}
 		if (tcp_is_connected()) {
 			char buf[1];
 			buf[0] = (char) c;
@@ -801,6 +1106,10 @@ void writeser(int c)
 	} else {
 		if (!serdev || !currprefs.use_serial)
 			return;
+		if (serio_running()) {
+			serial_io_write(c);
+			return;
+		}
 		if (datainoutput + 1 < sizeof(outputbuffer)) {
 			outputbuffer[datainoutput++] = c;
 		} else {
@@ -820,6 +1129,8 @@ int checkserwrite(int spaceneeded)
 		return 1;
 	}
 #endif
+	if (serio_running())
+		return (int)(SERIAL_IO_RING - serio_ring_used(&serio_tx)) >= spaceneeded;
 	outser();
 	if (datainoutput + spaceneeded >= sizeof(outputbuffer))
 		return 0;
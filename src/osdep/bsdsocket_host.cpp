@@ -39,12 +39,17 @@
 #include <sys/socket.h>
 #include <sys/select.h>
 #include <sys/ioctl.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 #ifdef HAVE_SYS_FILIO_H
 # include <sys/filio.h>
 #endif
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <cstddef>
+#include <climits>
 #include <netdb.h>
 
 #include <csignal>
@@ -439,21 +444,21 @@ static void mapsockoptvalue(int level, int optname, uae_u32 optval, void *buf)
 
 STATIC_INLINE int bsd_amigaside_FD_ISSET (int n, uae_u32 set)
 {
-	uae_u32 foo = get_long (set + (n / 32));
+	uae_u32 foo = get_long (set + (n / 32) * 4);
 	if (foo & (1 << (n % 32)))
 		return 1;
 	return 0;
 }
 
-STATIC_INLINE void bsd_amigaside_FD_ZERO (uae_u32 set)
+STATIC_INLINE void bsd_amigaside_FD_ZERO (uae_u32 set, int nfds)
 {
-	put_long (set, 0);
-	put_long (set + 4, 0);
+	for (int i = 0; i < nfds; i += 32, set += 4)
+		put_long (set, 0);
 }
 
 STATIC_INLINE void bsd_amigaside_FD_SET (int n, uae_u32 set)
 {
-	set = set + (n / 32);
+	set = set + (n / 32) * 4;
 	put_long (set, get_long (set) | (1 << (n % 32)));
 }
 
@@ -692,6 +697,38 @@ uae_u32 bsdthr_SendRecvAcceptConnect (uae_u32 (*tryfunc)(SB), SB)
 	return bsdthr_blockingstuff (tryfunc, sb);
 }
 
+#ifdef __linux__
+/* Sockets are added to the socket base's epoll set the first time the thread
+ * blocks on them and stay there until they are closed, so waiting costs one
+ * epoll_wait() instead of rebuilding fd_sets. Registrations are edge-triggered
+ * for every event type: stale edges from other sockets never make us spin,
+ * and the caller always retries the operation before waiting again.
+ * Returns 1 when s may be ready, 0 when aborted, -1 on error. */
+static int bsd_epoll_block(SB, int s)
+{
+	struct epoll_event ev[16];
+	int num, i, ready = 0;
+
+	ev[0].events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLRDHUP | EPOLLET;
+	ev[0].data.fd = s;
+	if (epoll_ctl(sb->epollfd, EPOLL_CTL_ADD, s, &ev[0]) < 0 && errno != EEXIST)
+		return -1;
+
+	while (!ready) {
+		num = epoll_wait(sb->epollfd, ev, sizeof ev / sizeof ev[0], -1);
+		if (num < 0)
+			return -1;
+		for (i = 0; i < num; i++) {
+			if (ev[i].data.fd == sb->sockabort[0])
+				return 0;
+			if (ev[i].data.fd == s)
+				ready = 1;
+		}
+	}
+	return 1;
+}
+#endif
+
 uae_u32 bsdthr_blockingstuff(uae_u32(*tryfunc)(SB), SB)
 {
 	int done = 0, foo = 0;
@@ -706,6 +743,25 @@ uae_u32 bsdthr_blockingstuff(uae_u32(*tryfunc)(SB), SB)
 		foo = tryfunc(sb);
 		if (foo < 0 && !nonblock) {
 			if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINPROGRESS)) {
+#ifdef __linux__
+				if (sb->epollfd >= 0) {
+					int num = bsd_epoll_block(sb, sb->s);
+					if (num < 0) {
+						write_log("Blocking epoll_wait(%d) returns -1,errno is %d\n", sb->sockabort[0], errno);
+						fcntl(sb->s, F_SETFL, flags);
+						return -1;
+					}
+					if (num == 0) {
+						write_log("select aborted from signal\n");
+						clearsockabort(sb);
+						errno = EINTR;
+						done = 1;
+					} else {
+						done = 0;
+					}
+					continue;
+				}
+#endif
 				fd_set readset, writeset, exceptset;
 				int maxfd = (sb->s > sb->sockabort[0]) ? sb->s : sb->sockabort[0];
 				int num;
@@ -875,6 +931,22 @@ int host_sbinit (TrapContext *ctx, SB)
 		return 0;
 	}
 
+	sb->epollfd = -1;
+#ifdef __linux__
+	sb->epollfd = epoll_create1 (EPOLL_CLOEXEC);
+	if (sb->epollfd >= 0) {
+		struct epoll_event ev{};
+		ev.events = EPOLLIN;
+		ev.data.fd = sb->sockabort[0];
+		if (epoll_ctl (sb->epollfd, EPOLL_CTL_ADD, sb->sockabort[0], &ev) < 0) {
+			close (sb->epollfd);
+			sb->epollfd = -1;
+		}
+	}
+	if (sb->epollfd < 0)
+		write_log ("BSDSOCK: epoll unavailable (%d), using select().\n", errno);
+#endif
+
 	/* Alloc hostent buffer */
 	sb->hostent = uae_AllocMem (ctx, 1024, 0, sb->sysbase);
 	sb->hostentsize = 1024;
@@ -883,6 +955,8 @@ int host_sbinit (TrapContext *ctx, SB)
 	if (uae_start_thread ("bsdsocket", bsdlib_threadfunc, (void *)sb, &sb->thread) == BAD_THREAD) {
 		write_log ("BSDSOCK: Failed to create thread.\n");
 		uae_sem_destroy (&sb->sem);
+		if (sb->epollfd >= 0)
+			close (sb->epollfd);
 		close (sb->sockabort[0]);
 		close (sb->sockabort[1]);
 		return 0;
@@ -912,6 +986,10 @@ void host_sbcleanup (SB)
 	uae_thread_id thread = sb->thread;
 	close (sb->sockabort[0]);
 	close (sb->sockabort[1]);
+	if (sb->epollfd >= 0) {
+		close (sb->epollfd);
+		sb->epollfd = -1;
+	}
 	for (i = 0; i < sb->dtablesize; i++) {
 		if (sb->dtable[i] != -1) {
 			close(sb->dtable[i]);
@@ -1428,11 +1506,10 @@ static void fd_zero(TrapContext *ctx, uae_u32 fdset, uae_u32 nfds)
 
 uae_u32 bsdthr_WaitSelect(SB)
 {
-	fd_set sets[3];
-	int i, s, set, a_s, max;
-	uae_u32 a_set;
-	struct timeval tv {};
-	int r;
+	struct pollfd *pfds;
+	int *amigafd;
+	int i, w, s, set, n, r, timeout_ms = -1;
+	uae_u32 bits[3], any;
 	TrapContext* ctx = NULL;  // FIXME: Correct?
 
 	write_log("WaitSelect: %d 0x%x 0x%x 0x%x 0x%x 0x%x\n", sb->nfds, sb->sets[0], sb->sets[1], sb->sets[2], sb->timeout, sb->sigmp);
@@ -1440,77 +1517,107 @@ uae_u32 bsdthr_WaitSelect(SB)
 	if (sb->timeout)
 		write_log("WaitSelect: timeout %d %d\n", get_long(sb->timeout), get_long(sb->timeout + 4));
 
-	FD_ZERO(&sets[0]);
-	FD_ZERO(&sets[1]);
-	FD_ZERO(&sets[2]);
+	/* poll() only looks at the descriptors that were asked for, instead of
+	 * every descriptor up to the highest one, and has no FD_SETSIZE limit. */
+	pfds = xmalloc(struct pollfd, sb->nfds + 1);
+	amigafd = xmalloc(int, sb->nfds + 1);
 
 	/* Set up the abort socket */
-	FD_SET(sb->sockabort[0], &sets[0]);
-	FD_SET(sb->sockabort[0], &sets[2]);
-	max = sb->sockabort[0];
-
-	for (set = 0; set < 3; set++) {
-		if (sb->sets[set] != 0) {
-			a_set = sb->sets[set];
-			for (i = 0; i < sb->nfds; i++) {
-				if (bsd_amigaside_FD_ISSET(i, a_set)) {
-					s = getsock(ctx, sb, i + 1);
-					write_log("WaitSelect: AmigaSide %d set. NativeSide %d.\n", i, s);
-					if (s == -1) {
-						write_log("BSDSOCK: WaitSelect() called with invalid descriptor %d in set %d.\n", i, set);
-					} else {
-						FD_SET(s, &sets[set]);
-						if (max < s) max = s;
-					}
-				}
+	pfds[0].fd = sb->sockabort[0];
+	pfds[0].events = POLLIN | POLLPRI;
+	pfds[0].revents = 0;
+	n = 1;
+
+	for (w = 0; w < sb->nfds; w += 32) {
+		for (set = 0; set < 3; set++)
+			bits[set] = sb->sets[set] ? get_long(sb->sets[set] + w / 8) : 0;
+		any = bits[0] | bits[1] | bits[2];
+		while (any) {
+			int b = __builtin_ctz(any);
+			any &= any - 1;
+			i = w + b;
+			if (i >= sb->nfds)
+				break;
+			s = getsock(ctx, sb, i + 1);
+			write_log("WaitSelect: AmigaSide %d set. NativeSide %d.\n", i, s);
+			if (s == -1) {
+				write_log("BSDSOCK: WaitSelect() called with invalid descriptor %d.\n", i);
+				continue;
 			}
+			pfds[n].fd = s;
+			pfds[n].events = 0;
+			pfds[n].revents = 0;
+			if (bits[0] & (1u << b))
+				pfds[n].events |= POLLIN;
+			if (bits[1] & (1u << b))
+				pfds[n].events |= POLLOUT;
+			if (bits[2] & (1u << b))
+				pfds[n].events |= POLLPRI;
+			amigafd[n] = i;
+			n++;
 		}
 	}
 
-	max++;
-
 	if (sb->timeout) {
-		tv.tv_sec = get_long(sb->timeout);
-		tv.tv_usec = get_long(sb->timeout + 4);
+		/* tv_secs can be anything up to 2^32-1, so work in 64 bits */
+		uae_s64 ms = (uae_s64)get_long(sb->timeout) * 1000 + ((uae_s64)get_long(sb->timeout + 4) + 999) / 1000;
+		timeout_ms = ms > INT_MAX ? INT_MAX : (int)ms;
 	}
 
-	write_log("Select going to select\n");
-	r = select(max, &sets[0], &sets[1], &sets[2], (sb->timeout == 0) ? NULL : &tv);
+	write_log("Select going to poll\n");
+	r = poll(pfds, n, timeout_ms);
 	write_log("Select returns %d, errno is %d\n", r, errno);
 	if (r > 0) {
+		for (set = 0; set < 3; set++)
+			if (sb->sets[set] != 0)
+				bsd_amigaside_FD_ZERO(sb->sets[set], sb->nfds);
 		/* Socket told us to abort */
-		if (FD_ISSET(sb->sockabort[0], &sets[0])) {
+		if (pfds[0].revents) {
 			/* read from the pipe to reset it */
 			write_log("WaitSelect aborted from signal\n");
 			r = 0;
-			for (set = 0; set < 3; set++)
-				if (sb->sets[set] != 0)
-					bsd_amigaside_FD_ZERO(sb->sets[set]);
 			clearsockabort(sb);
-		}
-		else
-			/* This is perhaps slightly inefficient, but I don't care.. */
-			for (set = 0; set < 3; set++) {
-				a_set = sb->sets[set];
-				if (a_set != 0) {
-					bsd_amigaside_FD_ZERO(a_set);
-					for (i = 0; i < sb->nfds; i++) {
-						a_s = getsock(ctx, sb, i + 1);
-						if (a_s != -1) {
-							if (FD_ISSET(a_s, &sets[set])) {
-								write_log("WaitSelect: NativeSide %d set. AmigaSide %d.\n", a_s, i);
-
-								bsd_amigaside_FD_SET(i, a_set);
-							}
-						}
+		} else {
+			/* report like select(): errors and hangups count as readable.
+			 * A descriptor closed behind our back (POLLNVAL) goes in the
+			 * exception set, or counts as an error when there is none, so
+			 * the caller sees it instead of waiting on it again. */
+			r = 0;
+			for (i = 1; i < n; i++) {
+				short rev = pfds[i].revents;
+				if (!rev)
+					continue;
+				write_log("WaitSelect: NativeSide %d set. AmigaSide %d.\n", pfds[i].fd, amigafd[i]);
+				if (rev & POLLNVAL) {
+					write_log("BSDSOCK: WaitSelect() descriptor %d is no longer valid.\n", amigafd[i]);
+					if (sb->sets[2] != 0) {
+						bsd_amigaside_FD_SET(amigafd[i], sb->sets[2]);
+						r++;
+						continue;
 					}
+					rev |= POLLERR;
+				}
+				if ((pfds[i].events & POLLIN) && (rev & (POLLIN | POLLHUP | POLLERR))) {
+					bsd_amigaside_FD_SET(amigafd[i], sb->sets[0]);
+					r++;
+				}
+				if ((pfds[i].events & POLLOUT) && (rev & (POLLOUT | POLLERR))) {
+					bsd_amigaside_FD_SET(amigafd[i], sb->sets[1]);
+					r++;
+				}
+				if ((pfds[i].events & POLLPRI) && (rev & POLLPRI)) {
+					bsd_amigaside_FD_SET(amigafd[i], sb->sets[2]);
+					r++;
 				}
 			}
+		}
 	} else if (r == 0) {         /* Timeout. I think we're supposed to clear the sets.. */
 		for (set = 0; set < 3; set++)
 			if (sb->sets[set] != 0)
-				bsd_amigaside_FD_ZERO(sb->sets[set]);
+				bsd_amigaside_FD_ZERO(sb->sets[set], sb->nfds);
 	}
+	xfree(amigafd);
+	xfree(pfds);
 	write_log("WaitSelect: r=%d errno=%d\n", r, errno);
 	return r;
 }
@@ -3,6 +3,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <algorithm>
+#include <vector>
 #include <dpi_handler.hpp>
 
 #include <guisan.hpp>
@@ -239,6 +240,16 @@ static void show_help_requested()
 	}
 }
 
+// Longest time a GUI loop sleeps waiting for input before it runs another iteration
+#define GUI_IDLE_TIMEOUT 100
+
+// Copy of the last surface contents uploaded to gui_texture, used to find the rows that changed
+static std::vector<Uint8> gui_shadow;
+static SDL_Texture* gui_shadow_texture = nullptr;
+static bool gui_texture_invalid = true;
+// Set when the window needs presenting again even though the GUI contents did not change
+static bool gui_present_needed = true;
+
 void cap_fps(Uint64 start)
 {
 	const auto end = SDL_GetPerformanceCounter();
@@ -250,13 +261,54 @@ void cap_fps(Uint64 start)
 
 	if (delay_time > 0.0f)
 		SDL_Delay(static_cast<Uint32>(delay_time));
+
+	// Nothing gets redrawn without an event, so sleep until one arrives instead of spinning.
+	// The event stays queued for the next SDL_PollEvent().
+	SDL_WaitEventTimeout(nullptr, GUI_IDLE_TIMEOUT);
+}
+
+// Returns false when the surface is unchanged since the last upload
+static bool upload_gui_texture()
+{
+	const int pitch = gui_screen->pitch;
+	const int h = gui_screen->h;
+	const size_t size = static_cast<size_t>(pitch) * h;
+	const auto* pixels = static_cast<const Uint8*>(gui_screen->pixels);
+
+	if (gui_texture_invalid || gui_shadow_texture != gui_texture || gui_shadow.size() != size)
+	{
+		SDL_UpdateTexture(gui_texture, nullptr, pixels, pitch);
+		gui_shadow.assign(pixels, pixels + size);
+		gui_shadow_texture = gui_texture;
+		gui_texture_invalid = false;
+		return true;
+	}
+
+	// guisan redraws the whole widget tree every time, so compare against the previous frame
+	// and only send the band of rows that actually changed.
+	int y0 = 0;
+	while (y0 < h && memcmp(pixels + y0 * pitch, &gui_shadow[y0 * pitch], pitch) == 0)
+		y0++;
+	if (y0 == h)
+		return false;
+	int y1 = h - 1;
+	while (y1 > y0 && memcmp(pixels + y1 * pitch, &gui_shadow[y1 * pitch], pitch) == 0)
+		y1--;
+
+	const SDL_Rect dirty = { 0, y0, gui_screen->w, y1 - y0 + 1 };
+	SDL_UpdateTexture(gui_texture, &dirty, pixels + y0 * pitch, pitch);
+	memcpy(&gui_shadow[y0 * pitch], pixels + y0 * pitch, static_cast<size_t>(y1 - y0 + 1) * pitch);
+	return true;
 }
 
 void update_gui_screen()
 {
 	const AmigaMonitor* mon = &AMonitors[0];
 
-	SDL_UpdateTexture(gui_texture, nullptr, gui_screen->pixels, gui_screen->pitch);
+	if (!upload_gui_texture() && !gui_present_needed)
+		return;
+	gui_present_needed = false;
+
 	if (amiberry_options.rotation_angle == 0 || amiberry_options.rotation_angle == 180)
 		gui_renderQuad = { 0, 0, gui_screen->w, gui_screen->h };
 	else
@@ -423,6 +475,9 @@ void amiberry_gui_halt()
 		SDL_DestroyTexture(gui_texture);
 		gui_texture = nullptr;
 	}
+	gui_shadow.clear();
+	gui_shadow_texture = nullptr;
+	gui_texture_invalid = true;
 	if (mon->gui_renderer && !kmsdrm_detected)
 	{
 		SDL_DestroyRenderer(mon->gui_renderer);
@@ -802,13 +857,23 @@ void check_input()
 		case SDL_MOUSEBUTTONDOWN:
 		case SDL_MOUSEBUTTONUP:
 		case SDL_MOUSEMOTION:
-		case SDL_RENDER_TARGETS_RESET:
-		case SDL_RENDER_DEVICE_RESET:
-		case SDL_WINDOWEVENT:
 		case SDL_DISPLAYEVENT:
 		case SDL_SYSWMEVENT:
 			got_event = 1;
 			break;
+
+		case SDL_WINDOWEVENT:
+			// Exposed, resized or moved: present again even if nothing changed
+			gui_present_needed = true;
+			got_event = 1;
+			break;
+
+		case SDL_RENDER_TARGETS_RESET:
+		case SDL_RENDER_DEVICE_RESET:
+			// Texture contents may be lost, resend the whole frame
+			gui_texture_invalid = true;
+			got_event = 1;
+			break;
 			
 		default:
 			break;
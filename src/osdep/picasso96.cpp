@@ -1348,7 +1348,7 @@ static void picasso_handle_vsync2(struct AmigaMonitor *mon)
 		mouseupdate(mon);
 	}
 
-	if (thisisvsync) {
+	if (thisisvsync && !warp_present_skipped()) {
 		rtg_render();
 #ifdef AVIOUTPUT
 		frame_drawn(monid);
@@ -4346,6 +4346,45 @@ void init_hz_p96(int monid)
 	write_log(_T("RTGFREQ: %d*%.4f = %.4f / %.1f = %d\n"), maxvpos_nom, vblank_hz, maxvpos_nom * vblank_hz, p96vblank, p96syncrate);
 }
 
+/* plane row scratch space for indirect mode, larger rows fall back to xmalloc() */
+#define P2X_STACKBUF 4096
+
+/* Convert eight pixels (byte g of the row, shifted left by bitoffset) from
+ * Depth planes into chunky indices in one go using the p2ctab transpose.
+ * Bytes at or beyond rowbytes are never read.
+ */
+STATIC_INLINE void p2c_gather8(uae_u8 *pix, uae_u8 **planes, int Depth, int g, int bitoffset, int rowbytes)
+{
+	uae_u32 a = 0, b = 0;
+	for (int k = 0; k < Depth; k++) {
+		uae_u8 *p = planes[k];
+		uae_u32 data;
+		if (p == &all_zeros_bitmap) {
+			data = 0x00;
+		} else if (p == &all_ones_bitmap) {
+			data = 0xFF;
+		} else {
+			data = p[g];
+			if (bitoffset) {
+				data <<= 8;
+				if (g + 1 < rowbytes)
+					data |= p[g + 1];
+				data = (uae_u8)(data >> (8 - bitoffset));
+			}
+		}
+		a |= p2ctab[data][0] << k;
+		b |= p2ctab[data][1] << k;
+	}
+	pix[0] = a >> 24;
+	pix[1] = a >> 16;
+	pix[2] = a >> 8;
+	pix[3] = a;
+	pix[4] = b >> 24;
+	pix[5] = b >> 16;
+	pix[6] = b >> 8;
+	pix[7] = b;
+}
+
 /* NOTE: Watch for those planeptrs of 0x00000000 and 0xFFFFFFFF for all zero / all one bitmaps !!!! */
 static void PlanarToChunky(TrapContext *ctx, struct RenderInfo *ri, struct BitMap *bm,
 	uae_u32 srcx, uae_u32 srcy, uae_u32 dstx, uae_u32 dsty,
@@ -4366,8 +4405,12 @@ static void PlanarToChunky(TrapContext *ctx, struct RenderInfo *ri, struct BitMa
 			uaecptr ap = bm->APlanes[j];
 			if (ap != 0 && ap != 0xffffffff) {
 				ap += srcx / 8 + srcy * bm->BytesPerRow;
+			} else if (ap == 0) {
+				specialplane[j] = true;
+				PLANAR[j] = &all_zeros_bitmap;
 			} else {
 				specialplane[j] = true;
+				PLANAR[j] = &all_ones_bitmap;
 			}
 			APLANAR[j] = ap;
 		} else {
@@ -4386,8 +4429,27 @@ static void PlanarToChunky(TrapContext *ctx, struct RenderInfo *ri, struct BitMa
 	if ((minterm != BLIT_FALSE && minterm != BLIT_TRUE && minterm != BLIT_NOTSRC && minterm != BLIT_SRC) || mask != 0xff) {
 		needin = true;
 	}
+
+	/* indirect mode: fetch each plane row with one trap_get_bytes() instead of a trap per byte */
+	uae_u8 stackbuf[P2X_STACKBUF];
+	uae_u8 *planebuf = NULL;
+	int rowbytes = (((width + 7) >> 3) + 2) & ~1;
+	if (indirect) {
+		planebuf = (size_t)rowbytes * Depth <= sizeof stackbuf ? stackbuf : xmalloc(uae_u8, rowbytes * Depth);
+	}
+
 	for (int rows = 0; rows < height; rows++, image += ri->BytesPerRow) {
 
+		if (indirect) {
+			for (int k = 0; k < Depth; k++) {
+				if (!specialplane[k]) {
+					PLANAR[k] = planebuf + rowbytes * k;
+					trap_get_bytes(ctx, PLANAR[k], APLANAR[k], rowbytes);
+					APLANAR[k] += bm->BytesPerRow;
+				}
+			}
+		}
+
 		for (int cols = 0; cols < width; cols += 8) {
 			uae_u32 a = 0, b = 0;
 			uae_u32 amask = 0, bmask = 0;
@@ -4409,24 +4471,13 @@ static void PlanarToChunky(TrapContext *ctx, struct RenderInfo *ri, struct BitMa
 			}
 			for (int k = 0; k < Depth; k++) {
 				uae_u32 data;
-				if (indirect) {
-					if (APLANAR[k] == 0) {
-						data = 0x00;
-					} else if (APLANAR[k] == 0xffffffff) {
-						data = 0xFF;
-					} else {
-						data = (uae_u8)(trap_get_word(ctx, APLANAR[k]) >> (8 - bitoffset));
-						APLANAR[k]++;
-					}
+				if (PLANAR[k] == &all_zeros_bitmap) {
+					data = 0x00;
+				} else if (PLANAR[k] == &all_ones_bitmap) {
+					data = 0xFF;
 				} else {
-					if (PLANAR[k] == &all_zeros_bitmap) {
-						data = 0x00;
-					} else if (PLANAR[k] == &all_ones_bitmap) {
-						data = 0xFF;
-					} else {
-						data = (uae_u8)(do_get_mem_word((uae_u16*)PLANAR[k]) >> (8 - bitoffset));
-						PLANAR[k]++;
-					}
+					data = (uae_u8)(do_get_mem_word((uae_u16*)PLANAR[k]) >> (8 - bitoffset));
+					PLANAR[k]++;
 				}
 				data &= msk;
 				a |= p2ctab[data][0] << k;
@@ -4527,13 +4578,17 @@ static void PlanarToChunky(TrapContext *ctx, struct RenderInfo *ri, struct BitMa
 				do_put_mem_long((uae_u32 *)(image + cols + 4), out1);
 			}
 		}
-		for (int j = 0; j < Depth; j++) {
-			if (!specialplane[j]) {
-				APLANAR[j] += eol_offset;
-				PLANAR[j] += eol_offset;
+		if (!indirect) {
+			for (int j = 0; j < Depth; j++) {
+				if (!specialplane[j]) {
+					PLANAR[j] += eol_offset;
+				}
 			}
 		}
 	}
+	if (planebuf && planebuf != stackbuf) {
+		xfree(planebuf);
+	}
 }
 
 static uae_u32 getcim(uae_u8 v, int bpp, int *maxcp, uaecptr acim, uae_u32 *cim, TrapContext *ctx)
@@ -4656,40 +4711,40 @@ static void PlanarToDirect(TrapContext *ctx, struct RenderInfo *ri, struct BitMa
 		}
 	}
 
+	/* indirect mode: one trap_get_bytes() per plane row, sized to the bytes actually covered */
+	int bitoffset = srcx & 7;
+	int rowbytes = (bitoffset + width + 7) >> 3;
+	uae_u8 stackbuf[P2X_STACKBUF];
 	uae_u8 *planebuf = NULL;
-	int planebuf_width = (width + 1) & ~1;
+	int planebuf_width = (rowbytes + 1) & ~1;
 	if (indirect) {
-		planebuf = xmalloc(uae_u8, planebuf_width * Depth);
+		planebuf = (size_t)planebuf_width * Depth <= sizeof stackbuf ? stackbuf : xmalloc(uae_u8, planebuf_width * Depth);
 	}
+	bool needin = minterm != BLIT_FALSE && minterm != BLIT_TRUE && minterm != BLIT_NOTSRC && minterm != BLIT_SRC;
 
-	int eol_offset = bm->BytesPerRow - ((width + (srcx & 7)) >> 3);
 	for (int rows = 0; rows < height; rows++, image += ri->BytesPerRow) {
 		uae_u8 *image2 = image;
-		uae_u32 bitoffs = 7 - (srcx & 7);
+		uae_u8 pix[8];
 
 		if (indirect) {
 			for (int k = 0; k < Depth; k++) {
 				if (!specialplane[k]) {
 					PLANAR[k] = planebuf + planebuf_width * k;
 					trap_get_bytes(ctx, PLANAR[k], APLANAR[k], planebuf_width);
+					APLANAR[k] += bm->BytesPerRow;
 				}
 			}
 		}
 
 		for (int cols = 0; cols < width; cols ++) {
-			uae_u8 v = 0;
-			for (int k = 0; k < Depth; k++) {
-				if (PLANAR[k] == &all_ones_bitmap)
-					v |= 1 << k;
-				else if (PLANAR[k] != &all_zeros_bitmap) {
-					v |= ((*PLANAR[k] >> bitoffs) & 1) << k;
-				}
+			if (!(cols & 7)) {
+				p2c_gather8(pix, PLANAR, Depth, cols >> 3, bitoffset, rowbytes);
 			}
-			v &= depthmask;
+			uae_u8 v = pix[cols & 7] & depthmask;
 			uae_u8 vi = (v ^ mask) & depthmask;
 
 			uae_u32 inval = 0;
-			if (minterm != BLIT_FALSE && minterm != BLIT_TRUE && minterm != BLIT_NOTSRC && minterm != BLIT_SRC) {
+			if (needin) {
 				switch (bpp)
 				{
 				case 2:
@@ -4781,28 +4836,17 @@ static void PlanarToDirect(TrapContext *ctx, struct RenderInfo *ri, struct BitMa
 				image2 += 4;
 				break;
 			}
-
-			bitoffs--;
-			bitoffs &= 7;
-			if (bitoffs == 7) {
-				int k;
-				for (k = 0; k < Depth; k++) {
-					if (!specialplane[k]) {
-						PLANAR[k]++;
-						APLANAR[k]++;
-					}
-				}
-			}
 		}
 
-		for (int i = 0; i < Depth; i++) {
-			if (!specialplane[i]) {
-				PLANAR[i] += eol_offset;
-				APLANAR[i] += eol_offset;
+		if (!indirect) {
+			for (int i = 0; i < Depth; i++) {
+				if (!specialplane[i]) {
+					PLANAR[i] += bm->BytesPerRow;
+				}
 			}
 		}
 	}
-	if (planebuf) {
+	if (planebuf && planebuf != stackbuf) {
 		xfree(planebuf);
 	}
 }
@@ -599,18 +599,26 @@ static void cirrus_invalidate_region(CirrusVGAState * s, int off_begin,
 				     int off_pitch, int bytesperline,
 				     int lines)
 {
-#if 0
-	int y;
+    int y;
     int off_cur;
     int off_cur_end;
 
+    if (off_pitch < 0) {
+        off_begin -= bytesperline - 1;
+    }
+
     for (y = 0; y < lines; y++) {
-	off_cur = off_begin;
-	off_cur_end = (off_cur + bytesperline) & s->cirrus_addr_mask;
-        memory_region_set_dirty(&s->vga.vram, off_cur, off_cur_end - off_cur);
-	off_begin += off_pitch;
+        off_cur = off_begin & s->cirrus_addr_mask;
+        off_cur_end = ((off_cur + bytesperline - 1) & s->cirrus_addr_mask) + 1;
+        if (off_cur_end >= off_cur) {
+            linear_memory_region_set_dirty(&s->vga.vram, off_cur, off_cur_end - off_cur);
+        } else {
+            /* wraparound */
+            linear_memory_region_set_dirty(&s->vga.vram, off_cur, s->cirrus_addr_mask + 1 - off_cur);
+            linear_memory_region_set_dirty(&s->vga.vram, 0, off_cur_end);
+        }
+        off_begin += off_pitch;
     }
-#endif
 }
 
 static int cirrus_bitblt_common_patterncopy(CirrusVGAState * s,
@@ -892,6 +892,10 @@ void sdl2_audio_callback(void* userdata, Uint8* stream, int len)
 	auto* sd = static_cast<sound_data*>(userdata);
 	auto* s = sd->data;
 
+	// SDL owns the audio thread, give it its role on first use
+	if (uae_thread_get_role() < 0)
+		uae_thread_set_role(UAE_THREAD_ROLE_AUDIO);
+
 	if (!s->stream_initialised || sd->mute) {
 		std::fill_n(stream, len, 0);
 		if (sd->mute) s->silence_written++;
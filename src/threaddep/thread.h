@@ -14,13 +14,18 @@
  * with different ones, make them look like POSIX semaphores. */
 typedef SDL_sem *uae_sem_t;
 
+/* Optional thread telemetry (amiberry.conf thread_telemetry): blocking
+ * semaphore waits are timed and counted per thread. */
+extern bool uae_thread_telemetry;
+int uae_sem_wait_telemetry(uae_sem_t* sem, int ms);
+
 int uae_sem_init(uae_sem_t* sem, int dummy, int initial_state);
 void uae_sem_destroy(uae_sem_t* event);
 #define uae_sem_post(PSEM) SDL_SemPost (*(PSEM))
 #define uae_sem_unpost(PSEM) SDL_SemPost (*(PSEM))
-#define uae_sem_wait(PSEM) SDL_SemWait (*(PSEM))
+#define uae_sem_wait(PSEM) (uae_thread_telemetry ? uae_sem_wait_telemetry(PSEM, -1) : SDL_SemWait (*(PSEM)))
 #define uae_sem_trywait(PSEM) SDL_SemTryWait (*(PSEM))
-#define uae_sem_trywait_delay(PSEM, ms) SDL_SemWaitTimeout(*(PSEM), ms)
+#define uae_sem_trywait_delay(PSEM, ms) (uae_thread_telemetry ? uae_sem_wait_telemetry(PSEM, ms) : SDL_SemWaitTimeout(*(PSEM), ms))
 #define uae_sem_getvalue(PSEM) SDL_SemValue (*(PSEM))
 
 #include "commpipe.h"
@@ -29,6 +34,24 @@ typedef SDL_Thread *uae_thread_id;
 #define BAD_THREAD 0
 typedef SDL_ThreadFunction uae_thread_function;
 
+/* Thread roles, used to apply the CPU affinity and scheduling policy
+ * configured in amiberry.conf. uae_start_thread() derives the role
+ * from the thread name, threads not created by us (main, SDL audio)
+ * call uae_thread_set_role() themselves. MAIN is the main thread while
+ * the CPU runs on its own thread: process defaults, no RT, no pinning. */
+enum uae_thread_role {
+	UAE_THREAD_ROLE_IO = 0,
+	UAE_THREAD_ROLE_EMU,
+	UAE_THREAD_ROLE_DRAW,
+	UAE_THREAD_ROLE_AUDIO,
+	UAE_THREAD_ROLE_MAIN,
+	UAE_THREAD_ROLE_MAX
+};
+
+void uae_thread_set_role(int role);
+int uae_thread_get_role(void);
+void uae_thread_telemetry_init(void);
+void uae_thread_telemetry_vsync(void);
 void uae_set_thread_priority(uae_thread_id* id, int pri);
 void uae_end_thread(uae_thread_id* thread);
 int uae_start_thread(const char* name, uae_thread_function fn, void* arg, uae_thread_id* thread);
@@ -1,8 +1,432 @@
 #include "sysconfig.h"
 #include "sysdeps.h"
 #include "uae.h"
+#include "options.h"
+#include "statusline.h"
 #include "thread.h"
 
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char *thread_role_names[UAE_THREAD_ROLE_MAX] = { "io", "emulation", "drawing", "audio", "main" };
+
+// threads not listed here are I/O helpers
+static const struct {
+	const char *name;
+	int role;
+} thread_roles[] = {
+	{ "cpu", UAE_THREAD_ROLE_EMU },
+	{ "drawing", UAE_THREAD_ROLE_DRAW },
+	{ "rtg", UAE_THREAD_ROLE_DRAW },
+	{ "mt32emu", UAE_THREAD_ROLE_AUDIO },
+	{ "cdimage_cdda_play", UAE_THREAD_ROLE_AUDIO },
+	{ nullptr, 0 }
+};
+
+static thread_local int current_thread_role = -1;
+
+/* Telemetry. Counters are only written by their own thread and sampled
+ * by uae_thread_telemetry_vsync() on the emulation thread, torn reads
+ * only cost an odd sample. */
+#define TELEMETRY_THREADS 64
+#define TELEMETRY_PIPES 64
+#define TELEMETRY_INTERVAL 1000000000ULL
+
+struct thread_telemetry {
+	char name[32];
+	int role;
+	bool used, active;
+#ifdef __linux__
+	clockid_t cpuclock;
+#endif
+	uae_u64 cpu_ns, wakeups, blocked_ns;
+	uae_u64 last_cpu_ns, last_wakeups, last_blocked_ns;
+};
+
+bool uae_thread_telemetry;
+static struct thread_telemetry telemetry_threads[TELEMETRY_THREADS];
+static thread_local struct thread_telemetry *current_telemetry;
+static struct comm_pipe_telemetry telemetry_pipes[TELEMETRY_PIPES];
+static volatile int telemetry_lock;
+static uae_u64 telemetry_last;
+static FILE *telemetry_file;
+
+static void telemetry_lock_get(void)
+{
+	while (__atomic_test_and_set(&telemetry_lock, __ATOMIC_ACQUIRE))
+		;
+}
+static void telemetry_lock_release(void)
+{
+	__atomic_clear(&telemetry_lock, __ATOMIC_RELEASE);
+}
+
+static uae_u64 telemetry_clock(clockid_t id)
+{
+	struct timespec ts;
+	if (clock_gettime(id, &ts))
+		return 0;
+	return (uae_u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Claim a slot for the calling thread, a restarted thread gets its old row back.
+static void telemetry_thread_start(const char *name, int role)
+{
+	if (!uae_thread_telemetry || current_telemetry)
+		return;
+	telemetry_lock_get();
+	struct thread_telemetry *tt = nullptr;
+	for (int i = 0; i < TELEMETRY_THREADS; i++) {
+		struct thread_telemetry *t = &telemetry_threads[i];
+		if (t->used && !t->active && !strcmp(t->name, name)) {
+			tt = t;
+			break;
+		}
+		if (!t->used && !tt)
+			tt = t;
+	}
+	if (tt) {
+		if (!tt->used) {
+			snprintf(tt->name, sizeof tt->name, "%s", name);
+			tt->used = true;
+		}
+		tt->role = role;
+#ifdef __linux__
+		if (pthread_getcpuclockid(pthread_self(), &tt->cpuclock))
+			tt->cpuclock = CLOCK_THREAD_CPUTIME_ID;
+#endif
+		tt->active = true;
+		current_telemetry = tt;
+	}
+	telemetry_lock_release();
+}
+
+static void telemetry_thread_end(void)
+{
+	struct thread_telemetry *tt = current_telemetry;
+	if (!tt)
+		return;
+	telemetry_lock_get();
+	tt->cpu_ns += telemetry_clock(CLOCK_THREAD_CPUTIME_ID);
+	tt->active = false;
+	current_telemetry = nullptr;
+	telemetry_lock_release();
+}
+
+int uae_sem_wait_telemetry(uae_sem_t *sem, int ms)
+{
+	struct thread_telemetry *tt = current_telemetry;
+	if (!tt)
+		return ms < 0 ? SDL_SemWait(*sem) : SDL_SemWaitTimeout(*sem, ms);
+	// don't count waits that didn't block
+	if (SDL_SemTryWait(*sem) == 0)
+		return 0;
+	if (ms == 0)
+		return SDL_MUTEX_TIMEDOUT;
+	uae_u64 t = telemetry_clock(CLOCK_MONOTONIC);
+	int v = ms < 0 ? SDL_SemWait(*sem) : SDL_SemWaitTimeout(*sem, ms);
+	tt->blocked_ns += telemetry_clock(CLOCK_MONOTONIC) - t;
+	tt->wakeups++;
+	return v;
+}
+
+void uae_telemetry_add_pipe(smp_comm_pipe *p)
+{
+	if (!uae_thread_telemetry)
+		return;
+	telemetry_lock_get();
+	int slot = -1;
+	for (int i = 0; i < TELEMETRY_PIPES; i++) {
+		// a pipe freed without destroy_comm_pipe() keeps its entry until
+		// another pipe is created at the same address
+		if (telemetry_pipes[i].pipe == p) {
+			slot = i;
+			break;
+		}
+		if (!telemetry_pipes[i].pipe && slot < 0)
+			slot = i;
+	}
+	if (slot >= 0) {
+		struct comm_pipe_telemetry *t = &telemetry_pipes[slot];
+		t->pipe = p;
+		t->name = p->name;
+		t->depth = t->hwm = t->hwm_total = 0;
+		p->telemetry = t;
+	}
+	telemetry_lock_release();
+}
+
+void uae_telemetry_remove_pipe(smp_comm_pipe *p)
+{
+	if (!p->telemetry)
+		return;
+	telemetry_lock_get();
+	if (p->telemetry->pipe == p)
+		p->telemetry->pipe = nullptr;
+	p->telemetry = nullptr;
+	telemetry_lock_release();
+}
+
+void uae_thread_telemetry_init(void)
+{
+	uae_thread_telemetry = amiberry_options.thread_telemetry;
+	if (!uae_thread_telemetry)
+		return;
+	telemetry_last = telemetry_clock(CLOCK_MONOTONIC);
+	if (amiberry_options.thread_telemetry_file[0] && !telemetry_file) {
+		telemetry_file = fopen(amiberry_options.thread_telemetry_file, "w");
+		if (telemetry_file)
+			fprintf(telemetry_file, "time,type,name,role,cpu_pct,wakeups,blocked_ms,depth,hwm,hwm_total\n");
+		else
+			write_log("Thread telemetry: can't create '%s'\n", amiberry_options.thread_telemetry_file);
+	}
+	write_log("Thread telemetry enabled\n");
+}
+
+static const char *telemetry_pipe_name(struct comm_pipe_telemetry *p)
+{
+	const char *n = p->name ? p->name : "pipe";
+	const char *b = strrchr(n, '/');
+	return b ? b + 1 : n;
+}
+
+// Once per second: per-thread CPU load, wakeups and blocked time plus
+// queue depths, to the CSV file and the on-screen status line.
+void uae_thread_telemetry_vsync(void)
+{
+	if (!uae_thread_telemetry)
+		return;
+	uae_u64 now = telemetry_clock(CLOCK_MONOTONIC);
+	uae_u64 elapsed = now - telemetry_last;
+	if (elapsed < TELEMETRY_INTERVAL)
+		return;
+	telemetry_last = now;
+	double secs = elapsed / 1000000000.0;
+	double t = now / 1000000000.0;
+	const char *busiest = nullptr;
+	double busiest_pct = 0;
+	const char *deepest = nullptr;
+	int deepest_hwm = 0;
+
+	telemetry_lock_get();
+	for (int i = 0; i < TELEMETRY_THREADS; i++) {
+		struct thread_telemetry *tt = &telemetry_threads[i];
+		if (!tt->used)
+			continue;
+		uae_u64 cpu = tt->cpu_ns;
+#ifdef __linux__
+		if (tt->active)
+			cpu += telemetry_clock(tt->cpuclock);
+#endif
+		double pct = cpu > tt->last_cpu_ns ? (cpu - tt->last_cpu_ns) / (elapsed / 100.0) : 0;
+		uae_u64 wakeups = tt->wakeups - tt->last_wakeups;
+		uae_u64 blocked = tt->blocked_ns - tt->last_blocked_ns;
+		tt->last_cpu_ns = cpu;
+		tt->last_wakeups = tt->wakeups;
+		tt->last_blocked_ns = tt->blocked_ns;
+		if (telemetry_file) {
+			fprintf(telemetry_file, "%.3f,thread,%s,%s,%.1f,%.0f,%.1f,,,\n", t, tt->name, thread_role_names[tt->role],
+				pct, wakeups / secs, blocked / 1000000.0 / secs);
+		}
+		if (pct > busiest_pct) {
+			busiest_pct = pct;
+			busiest = tt->name;
+		}
+	}
+	for (int i = 0; i < TELEMETRY_PIPES; i++) {
+		struct comm_pipe_telemetry *p = &telemetry_pipes[i];
+		if (!p->pipe)
+			continue;
+		int hwm = __atomic_exchange_n(&p->hwm, 0, __ATOMIC_RELAXED);
+		if (hwm > p->hwm_total)
+			p->hwm_total = hwm;
+		if (telemetry_file) {
+			int depth = __atomic_load_n(&p->depth, __ATOMIC_RELAXED);
+			fprintf(telemetry_file, "%.3f,pipe,%s,,,,,%d,%d,%d\n", t, telemetry_pipe_name(p), depth, hwm, p->hwm_total);
+		}
+		if (hwm > deepest_hwm) {
+			deepest_hwm = hwm;
+			deepest = telemetry_pipe_name(p);
+		}
+	}
+	telemetry_lock_release();
+	if (telemetry_file)
+		fflush(telemetry_file);
+
+	if (amiberry_options.thread_telemetry_overlay && busiest) {
+		if (deepest)
+			statusline_add_message(STATUSTYPE_OTHER, _T("%s %.0f%% | %s q%d"), busiest, busiest_pct, deepest, deepest_hwm);
+		else
+			statusline_add_message(STATUSTYPE_OTHER, _T("%s %.0f%%"), busiest, busiest_pct);
+	}
+}
+
+static int thread_role_from_name(const char *name)
+{
+	if (name) {
+		for (int i = 0; thread_roles[i].name; i++) {
+			if (!strcmp(thread_roles[i].name, name))
+				return thread_roles[i].role;
+		}
+	}
+	return UAE_THREAD_ROLE_IO;
+}
+
+#ifdef __linux__
+// "2", "2-3", "0,2-3"
+static bool parse_cpu_list(const char *s, cpu_set_t *set)
+{
+	CPU_ZERO(set);
+	bool any = false;
+	while (*s) {
+		char *end;
+		long first = strtol(s, &end, 10);
+		if (end == s)
+			return false;
+		long last = first;
+		s = end;
+		if (*s == '-') {
+			s++;
+			last = strtol(s, &end, 10);
+			if (end == s)
+				return false;
+			s = end;
+		}
+		for (long c = first; c <= last && c < CPU_SETSIZE; c++) {
+			if (c >= 0) {
+				CPU_SET(c, set);
+				any = true;
+			}
+		}
+		while (*s == ',' || *s == ' ')
+			s++;
+	}
+	return any;
+}
+
+static const char *thread_role_affinity(int role)
+{
+	switch (role)
+	{
+	case UAE_THREAD_ROLE_EMU:
+		return amiberry_options.thread_affinity_emulation;
+	case UAE_THREAD_ROLE_DRAW:
+		return amiberry_options.thread_affinity_drawing;
+	case UAE_THREAD_ROLE_AUDIO:
+		return amiberry_options.thread_affinity_audio;
+	case UAE_THREAD_ROLE_MAIN:
+		return "";
+	default:
+		return amiberry_options.thread_affinity_io;
+	}
+}
+
+// CPU mask of the process before any role was applied. Threads inherit
+// policy and affinity from their creator, so roles without an affinity
+// list go back to this mask instead of keeping the creator's pinning.
+static cpu_set_t process_affinity;
+static bool process_affinity_saved;
+#endif
+
+// Apply configured affinity and scheduling to the calling thread. Anything
+// the system refuses (no CAP_SYS_NICE, no such core) is logged and skipped.
+void uae_thread_set_role(int role)
+{
+	if (role < 0 || role >= UAE_THREAD_ROLE_MAX)
+		role = UAE_THREAD_ROLE_IO;
+	current_thread_role = role;
+	telemetry_thread_start(role == UAE_THREAD_ROLE_EMU || role == UAE_THREAD_ROLE_MAIN ? "main" : thread_role_names[role], role);
+	if (current_telemetry)
+		current_telemetry->role = role;
+#ifdef __linux__
+	// the first call comes from main() before anything was changed
+	if (!process_affinity_saved) {
+		if (!sched_getaffinity(0, sizeof process_affinity, &process_affinity))
+			process_affinity_saved = true;
+	}
+	const char *affinity = thread_role_affinity(role);
+	if (affinity[0]) {
+		cpu_set_t set;
+		if (!parse_cpu_list(affinity, &set)) {
+			write_log("Thread role %s: invalid CPU list '%s'\n", thread_role_names[role], affinity);
+		} else if (sched_setaffinity(0, sizeof set, &set)) {
+			write_log("Thread role %s: sched_setaffinity(%s) failed, %s\n", thread_role_names[role], affinity, strerror(errno));
+		}
+	} else if (process_affinity_saved) {
+		sched_setaffinity(0, sizeof process_affinity, &process_affinity);
+	}
+	bool rt = role != UAE_THREAD_ROLE_IO && role != UAE_THREAD_ROLE_MAIN &&
+		(!strcasecmp(amiberry_options.thread_rt_policy, "fifo") || !strcasecmp(amiberry_options.thread_rt_policy, "rr"));
+	if (!rt) {
+		// do not keep a real-time policy inherited from the creating thread
+		int policy;
+		struct sched_param sp = {};
+		if (!pthread_getschedparam(pthread_self(), &policy, &sp) && policy != SCHED_OTHER) {
+			sp.sched_priority = 0;
+			pthread_setschedparam(pthread_self(), SCHED_OTHER, &sp);
+		}
+	}
+	if (role == UAE_THREAD_ROLE_IO) {
+		if (amiberry_options.thread_io_nice) {
+			// per thread on Linux
+			if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), amiberry_options.thread_io_nice)) {
+				write_log("Thread role %s: nice %d failed, %s\n", thread_role_names[role], amiberry_options.thread_io_nice, strerror(errno));
+			}
+		}
+	} else if (rt) {
+		int policy = !strcasecmp(amiberry_options.thread_rt_policy, "fifo") ? SCHED_FIFO : SCHED_RR;
+		struct sched_param sp = {};
+		int pri = amiberry_options.thread_rt_priority;
+		// emulation above audio above drawing
+		if (role == UAE_THREAD_ROLE_DRAW)
+			pri -= 2;
+		else if (role == UAE_THREAD_ROLE_AUDIO)
+			pri -= 1;
+		if (pri < sched_get_priority_min(policy))
+			pri = sched_get_priority_min(policy);
+		if (pri > sched_get_priority_max(policy))
+			pri = sched_get_priority_max(policy);
+		sp.sched_priority = pri;
+		int err = pthread_setschedparam(pthread_self(), policy, &sp);
+		if (err) {
+			write_log("Thread role %s: %s priority %d not permitted (%s), using SDL priority\n",
+				thread_role_names[role], amiberry_options.thread_rt_policy, pri, strerror(err));
+			SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+		}
+	}
+#endif
+}
+
+int uae_thread_get_role(void)
+{
+	return current_thread_role;
+}
+
+struct thread_start_data {
+	uae_thread_function fn;
+	void *arg;
+	int role;
+	char name[32];
+};
+
+static int thread_start_role(void *v)
+{
+	auto *tsd = static_cast<struct thread_start_data*>(v);
+	uae_thread_function fn = tsd->fn;
+	void *arg = tsd->arg;
+	telemetry_thread_start(tsd->name, tsd->role);
+	uae_thread_set_role(tsd->role);
+	xfree(tsd);
+	int v2 = fn(arg);
+	telemetry_thread_end();
+	return v2;
+}
+
 int uae_start_thread_fast(uae_thread_function fn, void* arg, uae_thread_id* thread)
 {
 	return uae_start_thread(NULL, fn, arg, thread);
@@ -11,17 +435,24 @@ int uae_start_thread_fast(uae_thread_function fn, void* arg, uae_thread_id* thre
 int uae_start_thread(const char* name, uae_thread_function fn, void* arg, uae_thread_id* tid)
 {
 	auto result = 1;
+	int role = thread_role_from_name(name);
 	if (name != nullptr) {
-		write_log("uae_start_thread \"%s\" function at %p arg %p\n", name,
-			fn, arg);
+		write_log("uae_start_thread \"%s\" function at %p arg %p role %s\n", name,
+			fn, arg, thread_role_names[role]);
 	} else {
 		name = "StartThread";
 	}
 	
-	auto* thread = SDL_CreateThread(fn, name, arg);
+	auto* tsd = xmalloc(struct thread_start_data, 1);
+	tsd->fn = fn;
+	tsd->arg = arg;
+	tsd->role = role;
+	snprintf(tsd->name, sizeof tsd->name, "%s", name);
+	auto* thread = SDL_CreateThread(thread_start_role, name, tsd);
 	if (thread == nullptr)
 	{
 		write_log("ERROR creating thread, %s\n", SDL_GetError());
+		xfree(tsd);
 		result = 0;
 	}
 	if (tid) {
@@ -69,6 +500,9 @@ void uae_sem_destroy(uae_sem_t* event)
 
 void uae_set_thread_priority(uae_thread_id* id, int pri)
 {
+	// don't undo a configured nice level of I/O helpers
+	if (current_thread_role == UAE_THREAD_ROLE_IO && amiberry_options.thread_io_nice)
+		return;
 	SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
 }
 
@@ -560,6 +560,9 @@ static void hardware_trap_ack(TrapContext *ctx)
 	// ack call_hardware_trap
 	uaecptr task = get_long_host(data + RTAREA_TRAP_DATA_TASKWAIT);
 
+	// make direct RAM writes from trap_get_host_address() visible before the 68k resumes
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
 #if NEW_TRAP_DEBUG
 	write_log(_T("TRAP SLOT %d: ACK. TASK = %08x\n"), ctx->trap_slot, task);
 #endif
@@ -740,6 +743,7 @@ static uae_u32 call_hardware_trap_back(TrapContext *ctx, uae_u16 cmd, uae_u32 p1
 	put_long_host(data + 8, p2);
 	put_long_host(data + 12, p3);
 	put_long_host(data + 16, p4);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
 	put_word_host(status, cmd);
 
 	volatile uae_u8 *d = status + 3;
@@ -1053,6 +1057,34 @@ bool trap_valid_address(TrapContext *ctx, uaecptr addr, uae_u32 size)
 	return true;
 }
 
+/* Host pointer to addr..addr+size-1 if the trap handler can access it directly.
+ * With indirect traps the calling 68k task is parked waiting for the trap, so
+ * the trap thread can copy in/out of plain chip, fast or Z3 RAM itself instead
+ * of bouncing every RTAREA_TRAP_DATA_EXTRA_SIZE chunk through the 68k.
+ * Anything else (custom chip, IO, RTG, ROM, MMU, data cache) returns NULL and
+ * must use the chunked trap_put/get paths. */
+uae_u8 *trap_get_host_address(TrapContext *ctx, uaecptr addr, uae_u32 size)
+{
+	if (!size || !real_address_allowed())
+		return NULL;
+	if (trap_is_indirect_null(ctx)) {
+		if (currprefs.mmu_model || currprefs.cpu_data_cache)
+			return NULL;
+#ifdef DEBUGGER
+		if (memwatch_enabled)
+			return NULL;
+#endif
+		addrbank *ab = &get_mem_bank(addr);
+		if ((ab->flags & (ABFLAG_RAM | ABFLAG_INDIRECT | ABFLAG_IO | ABFLAG_RTG)) != ABFLAG_RAM || !ab->baseaddr)
+			return NULL;
+	}
+	if (!valid_address(addr, size))
+		return NULL;
+	// see RAM contents written by the 68k before it entered the trap
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return get_real_address(addr);
+}
+
 uae_u32 trap_get_dreg(TrapContext *ctx, int reg)
 {
 	if (trap_is_indirect_null(ctx)) {
@@ -1180,6 +1212,11 @@ void trap_put_bytes(TrapContext *ctx, const void *haddrp, uaecptr addr, int cnt)
 		return;
 	uae_u8 *haddr = (uae_u8*)haddrp;
 	if (trap_is_indirect_null(ctx)) {
+		uae_u8 *p = trap_get_host_address(ctx, addr, cnt);
+		if (p) {
+			memcpy(p, haddr, cnt);
+			return;
+		}
 		while (cnt > 0) {
 			int max = cnt > RTAREA_TRAP_DATA_EXTRA_SIZE ? RTAREA_TRAP_DATA_EXTRA_SIZE : cnt;
 			memcpy(ctx->host_trap_data + RTAREA_TRAP_DATA_EXTRA, haddr, max);
@@ -1205,6 +1242,11 @@ void trap_get_bytes(TrapContext *ctx, void *haddrp, uaecptr addr, int cnt)
 		return;
 	uae_u8 *haddr = (uae_u8*)haddrp;
 	if (trap_is_indirect_null(ctx)) {
+		uae_u8 *p = trap_get_host_address(ctx, addr, cnt);
+		if (p) {
+			memcpy(haddr, p, cnt);
+			return;
+		}
 		while (cnt > 0) {
 			int max = cnt > RTAREA_TRAP_DATA_EXTRA_SIZE ? RTAREA_TRAP_DATA_EXTRA_SIZE : cnt;
 			call_hardware_trap_back(ctx, TRAPCMD_PUT_BYTES, addr, ctx->amiga_trap_data + RTAREA_TRAP_DATA_EXTRA, max, 0);
@@ -1229,6 +1271,12 @@ void trap_put_longs(TrapContext *ctx, uae_u32 *haddr, uaecptr addr, int cnt)
 	if (cnt <= 0)
 		return;
 	if (trap_is_indirect_null(ctx)) {
+		uae_u8 *p = trap_get_host_address(ctx, addr, cnt * sizeof(uae_u32));
+		if (p) {
+			for (int i = 0; i < cnt; i++)
+				put_long_host(p + i * sizeof(uae_u32), *haddr++);
+			return;
+		}
 		while (cnt > 0) {
 			int max = cnt > RTAREA_TRAP_DATA_EXTRA_SIZE / sizeof(uae_u32) ? RTAREA_TRAP_DATA_EXTRA_SIZE / sizeof(uae_u32) : cnt;
 			for (int i = 0; i < max; i++) {
@@ -1251,6 +1299,12 @@ void trap_get_longs(TrapContext *ctx, uae_u32 *haddr, uaecptr addr, int cnt)
 	if (cnt <= 0)
 		return;
 	if (trap_is_indirect_null(ctx)) {
+		uae_u8 *p = trap_get_host_address(ctx, addr, cnt * sizeof(uae_u32));
+		if (p) {
+			for (int i = 0; i < cnt; i++)
+				*haddr++ = get_long_host(p + i * sizeof(uae_u32));
+			return;
+		}
 		while (cnt > 0) {
 			int max = cnt > RTAREA_TRAP_DATA_EXTRA_SIZE / sizeof(uae_u32) ? RTAREA_TRAP_DATA_EXTRA_SIZE / sizeof(uae_u32) : cnt;
 			call_hardware_trap_back(ctx, TRAPCMD_GET_LONGS, addr, ctx->amiga_trap_data + RTAREA_TRAP_DATA_EXTRA, max, 0);
@@ -1273,6 +1327,12 @@ void trap_put_words(TrapContext *ctx, uae_u16 *haddr, uaecptr addr, int cnt)
 	if (cnt <= 0)
 		return;
 	if (trap_is_indirect_null(ctx)) {
+		uae_u8 *p = trap_get_host_address(ctx, addr, cnt * sizeof(uae_u16));
+		if (p) {
+			for (int i = 0; i < cnt; i++)
+				put_word_host(p + i * sizeof(uae_u16), *haddr++);
+			return;
+		}
 		while (cnt > 0) {
 			int max = cnt > RTAREA_TRAP_DATA_EXTRA_SIZE / sizeof(uae_u16) ? RTAREA_TRAP_DATA_EXTRA_SIZE / sizeof(uae_u16) : cnt;
 			for (int i = 0; i < max; i++) {
@@ -1295,6 +1355,12 @@ void trap_get_words(TrapContext *ctx, uae_u16 *haddr, uaecptr addr, int cnt)
 	if (cnt <= 0)
 		return;
 	if (trap_is_indirect_null(ctx)) {
+		uae_u8 *p = trap_get_host_address(ctx, addr, cnt * sizeof(uae_u16));
+		if (p) {
+			for (int i = 0; i < cnt; i++)
+				*haddr++ = get_word_host(p + i * sizeof(uae_u16));
+			return;
+		}
 		while (cnt > 0) {
 			int max = cnt > RTAREA_TRAP_DATA_EXTRA_SIZE / sizeof(uae_u16) ? RTAREA_TRAP_DATA_EXTRA_SIZE / sizeof(uae_u16) : cnt;
 			call_hardware_trap_back(ctx, TRAPCMD_GET_WORDS, addr, ctx->amiga_trap_data + RTAREA_TRAP_DATA_EXTRA, max, 0);
@@ -24,6 +24,7 @@
 #include "diskutil.h"
 #include "fdi2raw.h"
 #include "uae.h"
+#include "threaddep/thread.h"
 // OS X does not have off64_t, fopen64, fseeko64 or ftello64, the functions are already 64bit
 #ifdef __MACH__
 #  define off64_t off_t
@@ -37,10 +38,27 @@
 #include "archivers/wrp/warp.h"
 
 static struct zfile *zlist = 0;
+/* zfiles are created and closed by several filesys unit threads */
+static volatile int zlist_lock;
+
+static void zlist_lock_get (void)
+{
+	while (__atomic_test_and_set (&zlist_lock, __ATOMIC_ACQUIRE))
+		;
+}
+static void zlist_lock_release (void)
+{
+	__atomic_clear (&zlist_lock, __ATOMIC_RELEASE);
+}
 
 const TCHAR *uae_archive_extensions[] = { _T("zip"), _T("rar"), _T("7z"), _T("lha"), _T("lzh"), _T("lzx"), _T("tar"), NULL };
 
 #define MAX_CACHE_ENTRIES 10
+/* decompressed archive members kept around after their volume is closed */
+#define MEMBER_CACHE_SIZE (64 * 1024 * 1024)
+static uae_sem_t zmembercache_sem;
+/* serialises archive handle reads that go through the shared parent zfile */
+static uae_sem_t zarchive_read_sem;
 
 const TCHAR *zfile_get_ext(const TCHAR *name)
 {
@@ -186,9 +204,11 @@ static struct zfile *zfile_create (struct zfile *prev, const TCHAR *originalname
 	if (!z)
 		return 0;
 	memset (z, 0, sizeof *z);
+	z->opencnt = 1;
+	zlist_lock_get ();
 	z->next = zlist;
 	zlist = z;
-	z->opencnt = 1;
+	zlist_lock_release ();
 	if (prev && prev->originalname)
 		z->originalname = my_strdup(prev->originalname);
 	else if (originalname)
@@ -215,9 +235,12 @@ static void zfile_free (struct zfile *f)
 	xfree (f);
 }
 
+static void zmembercache_flush (void);
+
 void zfile_exit (void)
 {
 	struct zfile *l;
+	zmembercache_flush ();
 	while ((l = zlist)) {
 		zlist = l->next;
 		zfile_free (l);
@@ -233,13 +256,11 @@ void zfile_fclose (struct zfile *f)
 		write_log (_T("zfile: tried to free already closed filehandle!\n"));
 		return;
 	}
-	f->opencnt--;
-	if (f->opencnt > 0)
+	if (__atomic_sub_fetch (&f->opencnt, 1, __ATOMIC_ACQ_REL) > 0)
 		return;
 	f->opencnt = -100;
 	if (f->parent) {
-		f->parent->opencnt--;
-		if (f->parent->opencnt <= 0)
+		if (__atomic_sub_fetch (&f->parent->opencnt, 1, __ATOMIC_ACQ_REL) <= 0)
 			zfile_fclose (f->parent);
 	}
 	if (f->archiveparent) {
@@ -247,25 +268,24 @@ void zfile_fclose (struct zfile *f)
 		f->archiveparent = NULL;
 	}
 	struct zfile *pl = NULL;
-	struct zfile *nxt;
-	struct zfile *l  = zlist;
+	struct zfile *l;
+	zlist_lock_get ();
+	l = zlist;
 	while (l != f) {
 		if (l == 0) {
+			zlist_lock_release ();
 			write_log (_T("zfile: tried to free already freed or nonexisting filehandle!\n"));
 			return;
 		}
 		pl = l;
 		l = l->next;
 	}
-	if (l)
-		nxt = l->next;
-	zfile_free (f);
-	if (l == 0)
-		return;
 	if(!pl)
-		zlist = nxt;
+		zlist = l->next;
 	else
-		pl->next = nxt;
+		pl->next = l->next;
+	zlist_lock_release ();
+	zfile_free (f);
 }
 
 static void removeext (TCHAR *s, const TCHAR *ext)
@@ -2151,7 +2171,7 @@ struct zfile *zfile_fopen_parent (struct zfile *z, const TCHAR *name, uae_u64 of
 		l->offset += z->offset;
 		z = z->parent;
 	}
-	z->opencnt++;
+	__atomic_add_fetch (&z->opencnt, 1, __ATOMIC_ACQ_REL);
 	return l;
 }
 
@@ -2364,6 +2384,14 @@ size_t zfile_fread(void *b, size_t l1, size_t l2, struct zfile *z)
 			if (l2 < 0)
 				l2 = 0;
 		}
+		struct zfile *p = z->parent;
+		if (p->data && p->datasize >= p->size && !p->zfileread) {
+			/* fully loaded parent: read without moving its position,
+			 * several handles may share it */
+			memcpy (b, p->data + p->offset + z->offset + z->seek, l1 * l2);
+			z->seek += l1 * l2;
+			return l2;
+		}
 		zfile_fseek (z->parent, z->seek + z->offset, SEEK_SET);
 		v = z->seek;
 		ret = zfile_fread (b, l1, l2, z->parent);
@@ -2792,6 +2820,9 @@ static struct zvolume *zvolume_alloc_2 (const TCHAR *name, struct zfile *z, unsi
 		zfile_fseek (z, 0, SEEK_END);
 		zv->archivesize = zfile_ftell (z);
 		zfile_fseek (z, pos, SEEK_SET);
+		struct mystat st;
+		if (my_stat (name, &st))
+			zv->archivemtime = st.mtime.tv_sec;
 	}
 	return zv;
 }
@@ -2987,6 +3018,8 @@ static int zfile_fopen_archive_recurse (struct zvolume *zv, int flags)
 	return 0;
 }
 
+static struct zfile *zfile_open_archive_shared (const TCHAR *path, int flags);
+
 static struct zvolume *prepare_recursive_volume (struct zvolume *zv, const TCHAR *path, int flags)
 {
 	struct zfile *zf = NULL;
@@ -2996,7 +3029,7 @@ static struct zvolume *prepare_recursive_volume (struct zvolume *zv, const TCHAR
 #ifdef ZFILE_DEBUG
 	write_log (_T("unpacking '%s'\n"), path);
 #endif
-	zf = zfile_open_archive (path, 0);
+	zf = zfile_open_archive_shared (path, 0);
 	if (!zf)
 		goto end;
 	zvnew = zfile_fopen_archive_ext (zv->parentz, zf, flags);
@@ -3255,6 +3288,10 @@ struct zvolume *zfile_fopen_archive (const TCHAR *filename, int flags)
 
 	if (!zf)
 		return NULL;
+	if (!zmembercache_sem)
+		uae_sem_init (&zmembercache_sem, 0, 1);
+	if (!zarchive_read_sem)
+		uae_sem_init (&zarchive_read_sem, 0, 1);
 	zf->zfdmask = flags;
 	zv = zfile_fopen_archive_ext (NULL, zf, flags);
 	if (!zv)
@@ -3568,15 +3605,137 @@ uae_s64 zfile_fsize_archive (struct zfile *d)
 
 int zfile_read_archive (struct zfile *d, void *b, unsigned int size)
 {
+	struct zfile *p = d->parent;
+	if (p && !(p->data && p->datasize >= p->size) && zarchive_read_sem) {
+		/* goes through the parent's position, one reader at a time */
+		uae_sem_wait (&zarchive_read_sem);
+		int v = (int)zfile_fread (b, 1, size, d);
+		uae_sem_post (&zarchive_read_sem);
+		return v;
+	}
 	return (int)zfile_fread (b, 1, size, d);
 }
 
 void zfile_close_archive (struct zfile *d)
 {
-	/* do nothing, keep file cached */
+	/* the unpacked member stays cached in its znode and the member cache */
+	zfile_fclose (d);
 }
 
-struct zfile *zfile_open_archive (const TCHAR *path, int flags)
+/* Decompressed archive members are cached per znode for the lifetime of
+ * the volume. The member cache below additionally keeps them across volume
+ * close and reopen (resets, remounting the same WHDLoad archive, more than
+ * one volume using the same archive), holding one reference to each zfile.
+ * The archive's size and modification time are part of the key, so an
+ * archive replaced on disk is unpacked again.
+ * Entries are evicted least recently used first when the total size goes
+ * over MEMBER_CACHE_SIZE. */
+struct zmembercache
+{
+	TCHAR *name;
+	uae_s64 size;
+	uae_s64 archivesize;
+	time_t archivemtime;
+	unsigned int offset;
+	time_t mtime;
+	struct zfile *f;
+	struct zmembercache *prev, *next;
+};
+static struct zmembercache *zmembercache_first, *zmembercache_last;
+static uae_s64 zmembercache_total;
+
+static bool zmembercache_match (struct zmembercache *zmc, struct znode *zn)
+{
+	return zmc->size == zn->size && zmc->offset == zn->offset && zmc->mtime == zn->mtime.tv_sec &&
+		zmc->archivesize == zn->volume->archivesize && zmc->archivemtime == zn->volume->archivemtime &&
+		!_tcscmp (zmc->name, zn->fullname);
+}
+
+static void zmembercache_unlink (struct zmembercache *zmc)
+{
+	if (zmc->prev)
+		zmc->prev->next = zmc->next;
+	else
+		zmembercache_first = zmc->next;
+	if (zmc->next)
+		zmc->next->prev = zmc->prev;
+	else
+		zmembercache_last = zmc->prev;
+	zmc->prev = zmc->next = NULL;
+}
+
+static void zmembercache_link (struct zmembercache *zmc)
+{
+	zmc->prev = NULL;
+	zmc->next = zmembercache_first;
+	if (zmembercache_first)
+		zmembercache_first->prev = zmc;
+	zmembercache_first = zmc;
+	if (!zmembercache_last)
+		zmembercache_last = zmc;
+}
+
+static void zmembercache_free (struct zmembercache *zmc)
+{
+	zmembercache_unlink (zmc);
+	zmembercache_total -= zmc->size;
+	zfile_fclose (zmc->f);
+	xfree (zmc->name);
+	xfree (zmc);
+}
+
+static void zmembercache_flush (void)
+{
+	while (zmembercache_first)
+		zmembercache_free (zmembercache_first);
+}
+
+static struct zfile *zmembercache_get (struct znode *zn)
+{
+	struct zfile *z = NULL;
+
+	if (!zmembercache_sem)
+		return NULL;
+	uae_sem_wait (&zmembercache_sem);
+	for (struct zmembercache *zmc = zmembercache_first; zmc; zmc = zmc->next) {
+		if (zmembercache_match (zmc, zn)) {
+			zmembercache_unlink (zmc);
+			zmembercache_link (zmc);
+			z = zmc->f;
+			__atomic_add_fetch (&z->opencnt, 1, __ATOMIC_ACQ_REL);
+			break;
+		}
+	}
+	uae_sem_post (&zmembercache_sem);
+	return z;
+}
+
+static void zmembercache_put (struct znode *zn, struct zfile *z)
+{
+	/* only fully unpacked in-memory data is worth keeping */
+	if (!zmembercache_sem || !z->data || z->archiveparent || z->parent || z->size != z->datasize)
+		return;
+	if (z->size > MEMBER_CACHE_SIZE / 4)
+		return;
+	struct zmembercache *zmc = xcalloc (struct zmembercache, 1);
+	zmc->name = my_strdup (zn->fullname);
+	zmc->size = zn->size;
+	zmc->archivesize = zn->volume->archivesize;
+	zmc->archivemtime = zn->volume->archivemtime;
+	zmc->offset = zn->offset;
+	zmc->mtime = zn->mtime.tv_sec;
+	zmc->f = z;
+	__atomic_add_fetch (&z->opencnt, 1, __ATOMIC_ACQ_REL);
+	uae_sem_wait (&zmembercache_sem);
+	zmembercache_link (zmc);
+	zmembercache_total += zmc->size;
+	while (zmembercache_total > MEMBER_CACHE_SIZE && zmembercache_last != zmc)
+		zmembercache_free (zmembercache_last);
+	uae_sem_post (&zmembercache_sem);
+}
+
+/* unpacked member shared by everything that opens it */
+static struct zfile *zfile_open_archive_shared (const TCHAR *path, int flags)
 {
 	struct zvolume *zv = get_zvolume (path);
 	struct znode *zn = get_znode (zv, path, TRUE);
@@ -3590,13 +3749,29 @@ struct zfile *zfile_open_archive (const TCHAR *path, int flags)
 	}
 	if (zn->vfile)
 		zn = zn->vfile;
-	z = archive_getzfile (zn, zn->volume->id, 0);
+	z = zmembercache_get (zn);
+	if (!z) {
+		z = archive_getzfile (zn, zn->volume->id, 0);
+		if (z)
+			zmembercache_put (zn, z);
+	}
 	if (z)
 		zfile_fseek (z, 0, SEEK_SET);
 	zn->f = z;
 	return zn->f;
 }
 
+/* Every open gets its own handle with its own position on top of the
+ * shared member, close it with zfile_close_archive(). */
+struct zfile *zfile_open_archive (const TCHAR *path, int flags)
+{
+	struct zfile *z = zfile_open_archive_shared (path, flags);
+
+	if (!z)
+		return NULL;
+	return zfile_fopen_parent (z, NULL, 0, zfile_size (z));
+}
+
 int zfile_exists_archive (const TCHAR *path, const TCHAR *rel)
 {
 	TCHAR tmp[MAX_DPATH];